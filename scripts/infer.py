@@ -27,6 +27,8 @@ arg_parser.add_argument('--separate-value', action='store_true')
 arg_parser.add_argument('--fp16', action='store_true')
 
 arg_parser.add_argument('--gpu-sim', action='store_true')
+arg_parser.add_argument('--fused-obs', action='store_true')
+arg_parser.add_argument('--stacked-obs', action='store_true')
 
 args = arg_parser.parse_args()
 
@@ -36,10 +38,13 @@ sim = madrona_escape_room.SimManager(
     num_worlds = args.num_worlds,
     rand_seed = 5,
     auto_reset = True,
+    fused_observations = args.fused_obs,
+    frame_stacking = args.stacked_obs,
 )
 
-obs, num_obs_features = setup_obs(sim)
-policy = make_policy(num_obs_features, args.num_channels, args.separate_value)
+obs, num_obs_features = setup_obs(sim, args.fused_obs, args.stacked_obs)
+policy = make_policy(num_obs_features, args.num_channels, args.separate_value,
+                     args.fused_obs, args.stacked_obs)
 
 weights = LearningState.load_policy_weights(args.ckpt_path)
 policy.load_state_dict(weights)
@@ -75,10 +80,16 @@ for i in range(args.num_steps):
         actions.numpy().tofile(action_log)
 
     print()
-    print("Self:", obs[0])
-    print("Partners:", obs[1])
-    print("Room Entities:", obs[2])
-    print("Lidar:", obs[3])
+    if args.stacked_obs:
+        print("Frames:", obs[0])
+        print("Newest Frame Slot:", obs[1])
+    elif args.fused_obs:
+        print("Observations:", obs[0])
+    else:
+        print("Self:", obs[0])
+        print("Partners:", obs[1])
+        print("Room Entities:", obs[2])
+        print("Lidar:", obs[3])
 
     print("Move Amount Probs")
     print(" ", np.array_str(probs[0][0].cpu().numpy(), precision=2, suppress_small=True))
@@ -13,7 +13,28 @@ from madrona_escape_room_learn.rnn import LSTM
 import math
 import torch
 
-def setup_obs(sim):
+def setup_obs(sim, fused_obs=False, stacked_obs=False):
+    if stacked_obs:
+        # Ring buffer of the last few fused observations, maintained by the
+        # simulator (SimManager(frame_stacking=True)). process_stacked_obs
+        # orders the frames newest first using the head index.
+        frames_tensor = sim.observation_frames_tensor().to_torch()
+        head_tensor = sim.observation_frame_head_tensor().to_torch()
+        N, A, num_frames, num_frame_features = frames_tensor.shape
+
+        return [
+            frames_tensor.view(N * A, num_frames, num_frame_features),
+            head_tensor.view(N * A, 1),
+        ], num_frames * num_frame_features
+
+    if fused_obs:
+        # Same features as the concatenation in process_obs, already packed
+        # by the simulator (SimManager(fused_observations=True))
+        fused_obs_tensor = sim.fused_observation_tensor().to_torch()
+        N, A, num_obs_features = fused_obs_tensor.shape
+
+        return [fused_obs_tensor.view(N * A, num_obs_features)], num_obs_features
+
     self_obs_tensor = sim.self_observation_tensor().to_torch()
     partner_obs_tensor = sim.partner_observations_tensor().to_torch()
     room_ent_obs_tensor = sim.room_entity_observations_tensor().to_torch()
@@ -75,7 +96,34 @@ def process_obs(self_obs, partner_obs, room_ent_obs,
         ids,
     ], dim=1)
 
-def make_policy(num_obs_features, num_channels, separate_value):
+def process_fused_obs(fused_obs):
+    assert(not torch.isnan(fused_obs).any())
+    assert(not torch.isinf(fused_obs).any())
+
+    return fused_obs
+
+def process_stacked_obs(frames, head):
+    assert(not torch.isnan(frames).any())
+    assert(not torch.isinf(frames).any())
+
+    num_frames = frames.shape[1]
+    frame_offsets = torch.arange(num_frames, device=frames.device)
+    slots = (head.long() - frame_offsets) % num_frames
+
+    ordered = torch.gather(frames, 1,
+        slots.unsqueeze(-1).expand(-1, -1, frames.shape[2]))
+
+    return ordered.view(frames.shape[0], -1)
+
+def make_policy(num_obs_features, num_channels, separate_value,
+                fused_obs=False, stacked_obs=False):
+    if stacked_obs:
+        process = process_stacked_obs
+    elif fused_obs:
+        process = process_fused_obs
+    else:
+        process = process_obs
+
     #encoder = RecurrentBackboneEncoder(
     #    net = MLP(
     #        input_dim = num_obs_features,
@@ -99,7 +147,7 @@ def make_policy(num_obs_features, num_channels, separate_value):
 
     if separate_value:
         backbone = BackboneSeparate(
-            process_obs = process_obs,
+            process_obs = process,
             actor_encoder = encoder,
             critic_encoder = RecurrentBackboneEncoder(
                 net = MLP(
@@ -116,7 +164,7 @@ def make_policy(num_obs_features, num_channels, separate_value):
         )
     else:
         backbone = BackboneShared(
-            process_obs = process_obs,
+            process_obs = process,
             encoder = encoder,
         )
 
@@ -8,6 +8,7 @@ arg_parser.add_argument('--num-worlds', type=int, required=True)
 arg_parser.add_argument('--num-steps', type=int, required=True)
 arg_parser.add_argument('--profile-renderer', action='store_true')
 arg_parser.add_argument('--gpu-id', type=int, default=0)
+arg_parser.add_argument('--task-timings', action='store_true')
 
 args = arg_parser.parse_args()
 
@@ -18,6 +19,7 @@ sim = madrona_escape_room.SimManager(
     auto_reset = True,
     rand_seed = 5,
     enable_batch_renderer = args.profile_renderer,
+    task_timings = args.task_timings,
 )
 
 actions = sim.action_tensor().to_torch()
@@ -34,3 +36,12 @@ for i in range(args.num_steps):
 end = time.time()
 
 print("FPS", args.num_steps * args.num_worlds / (end - start))
+
+if args.task_timings:
+    timings = sim.task_timings_tensor().to_torch().cpu()
+    phase_ns = timings[:-1].double()
+    num_steps = max(timings[-1].item(), 1)
+
+    for name, ns in zip(sim.task_phase_names(), phase_ns):
+        print(f"{name:14} {ns.item() / num_steps / 1000:10.3f} us/step "
+              f"{100 * ns.item() / max(phase_ns.sum().item(), 1):6.2f}%")
@@ -90,6 +90,8 @@ arg_parser.add_argument('--separate-value', action='store_true')
 arg_parser.add_argument('--fp16', action='store_true')
 
 arg_parser.add_argument('--gpu-sim', action='store_true')
+arg_parser.add_argument('--fused-obs', action='store_true')
+arg_parser.add_argument('--stacked-obs', action='store_true')
 arg_parser.add_argument('--profile-report', action='store_true')
 
 args = arg_parser.parse_args()
@@ -100,6 +102,8 @@ sim = madrona_escape_room.SimManager(
     num_worlds = args.num_worlds,
     rand_seed = 5,
     auto_reset = True,
+    fused_observations = args.fused_obs,
+    frame_stacking = args.stacked_obs,
 )
 
 ckpt_dir = Path(args.ckpt_dir)
@@ -113,8 +117,9 @@ else:
 
 ckpt_dir.mkdir(exist_ok=True, parents=True)
 
-obs, num_obs_features = setup_obs(sim)
-policy = make_policy(num_obs_features, args.num_channels, args.separate_value)
+obs, num_obs_features = setup_obs(sim, args.fused_obs, args.stacked_obs)
+policy = make_policy(num_obs_features, args.num_channels, args.separate_value,
+                     args.fused_obs, args.stacked_obs)
 
 actions = sim.action_tensor().to_torch()
 dones = sim.done_tensor().to_torch()
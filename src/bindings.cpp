@@ -1,8 +1,15 @@
 #include "mgr.hpp"
+#include "types.hpp"
 
 #include <madrona/macros.hpp>
 #include <madrona/py/bindings.hpp>
 
+#include <nanobind/ndarray.h>
+#include <nanobind/stl/string.h>
+
+#include <stdexcept>
+#include <string>
+
 namespace nb = nanobind;
 
 namespace madEscape {
@@ -21,7 +28,30 @@ NB_MODULE(madrona_escape_room, m) {
                             int64_t num_worlds,
                             int64_t rand_seed,
                             bool auto_reset,
-                            bool enable_batch_renderer) {
+                            bool enable_batch_renderer,
+                            const std::string &level_bank_path,
+                            bool compact_observations,
+                            bool fused_observations,
+                            bool frame_stacking,
+                            bool task_timings,
+                            int64_t num_workers,
+                            int64_t numa_node,
+                            bool pin_workers) {
+            // CPU worker placement covers one NUMA node per manager; to use
+            // several sockets, create one SimManager per node with its own
+            // numa_node and a share of the worlds
+            if (num_workers < 0 || num_workers > (int64_t)UINT32_MAX) {
+                throw std::invalid_argument(
+                    "SimManager: num_workers must be >= 0, got " +
+                    std::to_string(num_workers));
+            }
+
+            if (numa_node < -1 || numa_node > (int64_t)INT32_MAX) {
+                throw std::invalid_argument(
+                    "SimManager: numa_node must be a node index or -1, got " +
+                    std::to_string(numa_node));
+            }
+
             new (self) Manager(Manager::Config {
                 .execMode = exec_mode,
                 .gpuID = (int)gpu_id,
@@ -29,14 +59,84 @@ NB_MODULE(madrona_escape_room, m) {
                 .randSeed = (uint32_t)rand_seed,
                 .autoReset = auto_reset,
                 .enableBatchRenderer = enable_batch_renderer,
+                .levelBankPath = level_bank_path.empty() ?
+                    nullptr : level_bank_path.c_str(),
+                .numWorkers = (uint32_t)num_workers,
+                .numaNode = (int32_t)numa_node,
+                .pinWorkers = pin_workers,
+                .compactObservations = compact_observations,
+                .fusedObservations = fused_observations,
+                .frameStacking = frame_stacking,
+                .taskTimings = task_timings,
             });
         }, nb::arg("exec_mode"),
            nb::arg("gpu_id"),
            nb::arg("num_worlds"),
            nb::arg("rand_seed"),
            nb::arg("auto_reset"),
-           nb::arg("enable_batch_renderer") = false)
-        .def("step", &Manager::step)
+           nb::arg("enable_batch_renderer") = false,
+           nb::arg("level_bank_path") = "",
+           nb::arg("compact_observations") = false,
+           nb::arg("fused_observations") = false,
+           nb::arg("frame_stacking") = false,
+           nb::arg("task_timings") = false,
+           nb::arg("num_workers") = 0,
+           nb::arg("numa_node") = -1,
+           nb::arg("pin_workers") = false)
+        .def("step", [](Manager &mgr, int64_t num_steps) {
+            if (num_steps < 1 || num_steps > (int64_t)INT32_MAX) {
+                throw std::invalid_argument(
+                    "step: num_steps must be at least 1, got " +
+                    std::to_string(num_steps));
+            }
+
+            mgr.step((int32_t)num_steps);
+        }, nb::arg("num_steps") = 1)
+        .def("set_actions", [](Manager &mgr,
+                               nb::ndarray<int32_t, nb::c_contig,
+                                           nb::device::cpu> actions) {
+            // Rows of (move_amount, move_angle, rotate, grab)
+            static_assert(sizeof(Action) == 4 * sizeof(int32_t));
+            if (actions.ndim() != 2 || actions.shape(1) != 4) {
+                throw std::invalid_argument(
+                    "set_actions: expected an [num_agents, 4] array");
+            }
+
+            int64_t num_agents = (int64_t)actions.shape(0);
+            int64_t max_agents =
+                (int64_t)mgr.numWorlds() * consts::numAgents;
+            if (num_agents > max_agents) {
+                throw std::invalid_argument(
+                    "set_actions: " + std::to_string(num_agents) +
+                    " actions for " + std::to_string(max_agents) +
+                    " agents");
+            }
+
+            mgr.setActions((const Action *)actions.data(), num_agents);
+        }, nb::arg("actions"))
+        .def("trigger_resets", [](Manager &mgr,
+                                  nb::ndarray<int32_t, nb::c_contig,
+                                              nb::device::cpu> world_idxs) {
+            if (world_idxs.ndim() != 1) {
+                throw std::invalid_argument(
+                    "trigger_resets: expected a 1D array of world indices");
+            }
+
+            const int32_t *idxs = world_idxs.data();
+            int64_t num_worlds = (int64_t)world_idxs.shape(0);
+            for (int64_t i = 0; i < num_worlds; i++) {
+                if (idxs[i] < 0 || idxs[i] >= (int64_t)mgr.numWorlds()) {
+                    throw std::out_of_range(
+                        "trigger_resets: world " + std::to_string(idxs[i]) +
+                        " out of range [0, " +
+                        std::to_string(mgr.numWorlds()) + ")");
+                }
+            }
+
+            mgr.triggerResets(idxs, num_worlds);
+        }, nb::arg("world_idxs"))
+        .def("reset", &Manager::reset)
+        .def("refresh_observations", &Manager::refreshObservations)
         .def("reset_tensor", &Manager::resetTensor)
         .def("action_tensor", &Manager::actionTensor)
         .def("reward_tensor", &Manager::rewardTensor)
@@ -49,6 +149,30 @@ NB_MODULE(madrona_escape_room, m) {
              &Manager::doorObservationTensor)
         .def("lidar_tensor", &Manager::lidarTensor)
         .def("steps_remaining_tensor", &Manager::stepsRemainingTensor)
+        .def("level_select_tensor", &Manager::levelSelectTensor)
+        .def("button_presses_tensor", &Manager::buttonPressesTensor)
+        .def("self_observation_f16_tensor",
+             &Manager::selfObservationF16Tensor)
+        .def("partner_observations_f16_tensor",
+             &Manager::partnerObservationsF16Tensor)
+        .def("room_entity_observations_f16_tensor",
+             &Manager::roomEntityObservationsF16Tensor)
+        .def("door_observation_f16_tensor",
+             &Manager::doorObservationF16Tensor)
+        .def("lidar_u8_tensor", &Manager::lidarU8Tensor)
+        .def("fused_observation_tensor", &Manager::fusedObservationTensor)
+        .def("observation_frames_tensor", &Manager::observationFramesTensor)
+        .def("observation_frame_head_tensor",
+             &Manager::observationFrameHeadTensor)
+        .def("task_timings_tensor", &Manager::taskTimingsTensor)
+        .def_static("task_phase_names", []() {
+            nb::list names;
+            for (const char *name : Manager::taskPhaseNames()) {
+                names.append(name);
+            }
+            return names;
+        })
+        .def("print_task_timings", &Manager::printTaskTimings)
         .def("rgb_tensor", &Manager::rgbTensor)
         .def("depth_tensor", &Manager::depthTensor)
     ;
@@ -16,6 +16,13 @@ inline constexpr madrona::CountT numAgents = 2;
 // in order to setup the fixed-size learning tensors appropriately.
 inline constexpr madrona::CountT maxEntitiesPerRoom = 6;
 
+// Upper bounds on the number of cubes and buttons a single room type places.
+// Together with numRooms these size the per-world pool of level entities
+// (LevelEntityPool in src/types.hpp).
+inline constexpr madrona::CountT maxCubesPerRoom = 3;
+inline constexpr madrona::CountT maxButtonsPerRoom = 2;
+static_assert(maxCubesPerRoom + maxButtonsPerRoom <= maxEntitiesPerRoom);
+
 // Various world / entity size parameters
 inline constexpr float worldLength = 80.f;
 inline constexpr float worldWidth = 20.f;
@@ -41,6 +48,11 @@ inline constexpr madrona::CountT numTurnBuckets = 5;
 // Number of lidar samples, arranged in circle around agent
 inline constexpr madrona::CountT numLidarSamples = 30;
 
+// Number of past observation frames kept per agent when frame stacking is
+// enabled (ObservationFrames). Fixed at compile time, since it sizes the
+// component.
+inline constexpr madrona::CountT numStackedFrames = 4;
+
 // Time (seconds) per step
 inline constexpr float deltaT = 0.04f;
 
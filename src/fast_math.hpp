@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Polynomial approximations of the trig functions used on the simulator's
+// hot paths (observations, lidar and movement), along with the trig::
+// functions sim code calls, which pick between these and libm at compile
+// time. Configure with -DMADESCAPE_FAST_TRIG=ON to use the approximations,
+// eval builds can keep the default libm path.
+//
+// Max absolute error vs double precision, measured in float over the input
+// ranges the sim uses (src/tests/fast_math_test checks these against libm):
+//   fastmath::sin / cos, |x| <= 4pi:  2.5e-7
+//   fastmath::atan2, any y, x:        3.1e-7 rad
+// Accuracy of sin / cos degrades with larger inputs, to ~3e-5 at |x| ~ 1e3.
+
+#ifndef MADESCAPE_FAST_TRIG
+#define MADESCAPE_FAST_TRIG 0
+#endif
+
+namespace madEscape {
+
+namespace fastmath {
+
+inline constexpr float pi = 3.14159265358979323846f;
+inline constexpr float halfPi = pi / 2.f;
+
+namespace detail {
+
+// 2pi split into a float and the float rounding error of it, so range
+// reduction doesn't lose precision for multi-turn angles
+inline constexpr float twoPiHi = 6.28318548f;
+inline constexpr float twoPiLo = -1.7484555e-7f;
+inline constexpr float invTwoPi = 0.159154943f;
+
+// atan(x) / x = sum atanCoeffs[i] * x^2i for x in [0, 1].
+// Abramowitz & Stegun 4.4.49, |error| <= 2e-8.
+inline constexpr float atanCoeffs[] = {
+    1.f,
+    -0.3333314528f,
+    0.1999355085f,
+    -0.1420889944f,
+    0.1065626393f,
+    -0.0752896400f,
+    0.0429096138f,
+    -0.0161657367f,
+    0.0028662257f,
+};
+inline constexpr int32_t numAtanCoeffs = 9;
+
+constexpr float absf(float x)
+{
+    return x < 0.f ? -x : x;
+}
+
+constexpr float roundNearest(float x)
+{
+    return float(int32_t(x + (x >= 0.f ? 0.5f : -0.5f)));
+}
+
+// Wraps x to [-pi, pi]
+constexpr float reduceAngle(float x)
+{
+    float k = roundNearest(x * invTwoPi);
+    return (x - k * twoPiHi) - k * twoPiLo;
+}
+
+// Taylor series through x^11, error < 6e-8 on [-pi/2, pi/2]
+constexpr float sinPoly(float x)
+{
+    float x2 = x * x;
+    float p = -2.50521084e-8f;
+    p = p * x2 + 2.75573192e-6f;
+    p = p * x2 - 1.98412698e-4f;
+    p = p * x2 + 8.33333333e-3f;
+    p = p * x2 - 1.66666667e-1f;
+    return x + x * x2 * p;
+}
+
+// Taylor series through x^12, error < 7e-9 on [-pi/2, pi/2]
+constexpr float cosPoly(float x)
+{
+    float x2 = x * x;
+    float p = 2.08767570e-9f;
+    p = p * x2 - 2.75573192e-7f;
+    p = p * x2 + 2.48015873e-5f;
+    p = p * x2 - 1.38888889e-3f;
+    p = p * x2 + 4.16666667e-2f;
+    p = p * x2 - 0.5f;
+    return 1.f + x2 * p;
+}
+
+constexpr float atanUnit(float x)
+{
+    float x2 = x * x;
+    float p = atanCoeffs[numAtanCoeffs - 1];
+    for (int32_t i = numAtanCoeffs - 2; i >= 0; i--) {
+        p = p * x2 + atanCoeffs[i];
+    }
+    return p * x;
+}
+
+}
+
+constexpr float sin(float x)
+{
+    x = detail::reduceAngle(x);
+
+    // sin(x) = sin(pi - x)
+    if (x > halfPi) {
+        x = pi - x;
+    } else if (x < -halfPi) {
+        x = -pi - x;
+    }
+
+    return detail::sinPoly(x);
+}
+
+constexpr float cos(float x)
+{
+    x = detail::absf(detail::reduceAngle(x));
+
+    // cos(x) = -cos(pi - x)
+    if (x > halfPi) {
+        return -detail::cosPoly(pi - x);
+    }
+
+    return detail::cosPoly(x);
+}
+
+// Same conventions as atan2f, except that signed zeros are treated as +0:
+// atan2(+-0, +-0) is +0 and atan2(-0, x < 0) is pi rather than -pi
+constexpr float atan2(float y, float x)
+{
+    float abs_y = detail::absf(y);
+    float abs_x = detail::absf(x);
+
+    float num = abs_y < abs_x ? abs_y : abs_x;
+    float denom = abs_y < abs_x ? abs_x : abs_y;
+    if (denom == 0.f) {
+        return 0.f;
+    }
+
+    float theta = detail::atanUnit(num / denom);
+    if (abs_y > abs_x) {
+        theta = halfPi - theta;
+    }
+    if (x < 0.f) {
+        theta = pi - theta;
+    }
+    if (y < 0.f) {
+        theta = -theta;
+    }
+
+    return theta;
+}
+
+namespace detail {
+
+constexpr bool approxEqual(float a, float b)
+{
+    return absf(a - b) <= 5e-7f;
+}
+
+}
+
+// Spot checks at exactly known values, evaluated at compile time
+static_assert(detail::approxEqual(sin(0.f), 0.f));
+static_assert(detail::approxEqual(sin(pi / 6.f), 0.5f));
+static_assert(detail::approxEqual(sin(-halfPi), -1.f));
+static_assert(detail::approxEqual(sin(2.5f * pi), 1.f));
+static_assert(detail::approxEqual(cos(0.f), 1.f));
+static_assert(detail::approxEqual(cos(pi / 3.f), 0.5f));
+static_assert(detail::approxEqual(cos(pi), -1.f));
+static_assert(detail::approxEqual(cos(2.f * pi), 1.f));
+static_assert(detail::approxEqual(atan2(1.f, 1.f), pi / 4.f));
+static_assert(detail::approxEqual(atan2(1.f, -1.f), 3.f * pi / 4.f));
+static_assert(detail::approxEqual(atan2(-1.f, 0.f), -halfPi));
+static_assert(detail::approxEqual(atan2(0.f, -1.f), pi));
+
+}
+
+// Trig entry points for sim code, selected by MADESCAPE_FAST_TRIG
+namespace trig {
+
+#if MADESCAPE_FAST_TRIG
+inline float sin(float x) { return fastmath::sin(x); }
+inline float cos(float x) { return fastmath::cos(x); }
+inline float atan2(float y, float x) { return fastmath::atan2(y, x); }
+#else
+inline float sin(float x) { return sinf(x); }
+inline float cos(float x) { return cosf(x); }
+inline float atan2(float y, float x) { return atan2f(y, x); }
+#endif
+
+}
+
+}
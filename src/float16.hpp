@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace madEscape {
+
+// Converts f to the bit pattern of the nearest IEEE 754 half precision
+// value (round to nearest even). Values beyond the fp16 range become
+// infinity, NaNs stay NaN. Used to fill the compact observation exports, so
+// it is plain integer code that runs on both backends.
+inline uint16_t floatToHalf(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(float));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs_bits = bits & 0x7FFFFFFF;
+
+    // Inf / NaN, keeping NaNs quiet
+    if (abs_bits >= 0x7F800000) {
+        return uint16_t(sign | 0x7C00 |
+            (abs_bits > 0x7F800000 ? 0x200 : 0));
+    }
+
+    // Rounds to infinity: >= 65520
+    if (abs_bits >= 0x477FF000) {
+        return uint16_t(sign | 0x7C00);
+    }
+
+    // Normal fp16 range: >= 2^-14
+    if (abs_bits >= 0x38800000) {
+        uint32_t rebiased = abs_bits - 0x38000000;
+        uint32_t round = 0xFFF + ((rebiased >> 13) & 1);
+        return uint16_t(sign | ((rebiased + round) >> 13));
+    }
+
+    // Subnormal or zero: shift the mantissa with its implicit bit into
+    // place, rounding on the bits shifted out
+    if (abs_bits < 0x33000000) {
+        return uint16_t(sign);
+    }
+
+    uint32_t exponent = abs_bits >> 23;
+    uint32_t mantissa = (abs_bits & 0x7FFFFF) | 0x800000;
+    uint32_t shift = 126 - exponent;
+    uint32_t half_mantissa = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+
+    if (remainder > halfway ||
+            (remainder == halfway && (half_mantissa & 1) != 0)) {
+        half_mantissa += 1;
+    }
+
+    return uint16_t(sign | half_mantissa);
+}
+
+}
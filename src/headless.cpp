@@ -1,11 +1,14 @@
 #include "mgr.hpp"
+#include "types.hpp"
 
+#include <algorithm>
 #include <cstdio>
 #include <chrono>
 #include <string>
 #include <filesystem>
 #include <fstream>
 #include <random>
+#include <vector>
 
 #include <madrona/heap_array.hpp>
 
@@ -23,12 +26,272 @@ using namespace madrona;
             sizeof(uint32_t) * total_num_steps * 2 * 3);
 }
 
+// Parses a comma separated list of counts, e.g. "1024,4096,16384". Returns
+// false if any entry is empty, not a decimal number or doesn't fit in 32
+// bits.
+static bool parseCountList(const char *list, std::vector<uint32_t> &counts)
+{
+    counts.clear();
+
+    std::string str(list);
+    size_t start = 0;
+    while (start <= str.size()) {
+        size_t end = str.find(',', start);
+        if (end == std::string::npos) {
+            end = str.size();
+        }
+
+        std::string entry = str.substr(start, end - start);
+        if (entry.empty() || entry.size() > 10 ||
+                entry.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+
+        uint64_t count = std::stoull(entry);
+        if (count > UINT32_MAX) {
+            return false;
+        }
+
+        counts.push_back((uint32_t)count);
+        start = end + 1;
+    }
+
+    return true;
+}
+
+// Per-step latency statistics of one kind of step, in microseconds
+struct StepLatencyStats {
+    int64_t count;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+static StepLatencyStats computeLatencyStats(std::vector<int64_t> &step_ns)
+{
+    StepLatencyStats stats {};
+    stats.count = (int64_t)step_ns.size();
+    if (step_ns.empty()) {
+        return stats;
+    }
+
+    std::sort(step_ns.begin(), step_ns.end());
+
+    double total_ns = 0.0;
+    for (int64_t ns : step_ns) {
+        total_ns += (double)ns;
+    }
+
+    // Nearest-rank percentiles
+    auto percentile = [&](double p) {
+        size_t rank = (size_t)(p * (double)step_ns.size() + 0.999999);
+        rank = std::clamp(rank, (size_t)1, step_ns.size());
+        return (double)step_ns[rank - 1] / 1000.0;
+    };
+
+    stats.mean = total_ns / (double)step_ns.size() / 1000.0;
+    stats.p50 = percentile(0.5);
+    stats.p90 = percentile(0.9);
+    stats.p99 = percentile(0.99);
+    stats.max = (double)step_ns.back() / 1000.0;
+
+    return stats;
+}
+
+struct BenchmarkRun {
+    uint32_t numWorlds;
+    uint32_t numWorkers;
+    double stepSeconds;
+    double wallSeconds;
+    StepLatencyStats normalSteps;
+    StepLatencyStats resetSteps;
+};
+
+// Steps a fresh manager for num_warmup_steps untimed steps, then times
+// num_steps steps individually. Every reset_interval-th step (0 to never
+// reset) resets all worlds and is accounted separately. Random actions are
+// drawn before timing starts, the timed loop only cycles through them.
+static BenchmarkRun runBenchmark(madEscape::Manager::Config cfg,
+                                 uint32_t num_worlds,
+                                 uint32_t num_workers,
+                                 int64_t num_warmup_steps,
+                                 int64_t num_steps,
+                                 int64_t reset_interval,
+                                 bool rand_actions)
+{
+    using namespace madEscape;
+
+    cfg.numWorlds = num_worlds;
+    cfg.numWorkers = num_workers;
+    Manager mgr(cfg);
+
+    constexpr CountT num_action_sets = 16;
+    CountT num_agents = (CountT)num_worlds * consts::numAgents;
+
+    std::mt19937 rand_gen(5);
+    std::uniform_int_distribution<int32_t> act_rand(0, 4);
+
+    HeapArray<Action> action_sets(num_action_sets * num_agents);
+    for (CountT i = 0; i < action_sets.size(); i++) {
+        action_sets[i] = Action {
+            .moveAmount = act_rand(rand_gen),
+            .moveAngle = act_rand(rand_gen),
+            .rotate = act_rand(rand_gen),
+            .grab = 0,
+        };
+    }
+
+    HeapArray<int32_t> all_worlds(num_worlds);
+    for (CountT i = 0; i < (CountT)num_worlds; i++) {
+        all_worlds[i] = (int32_t)i;
+    }
+
+    std::vector<int64_t> normal_step_ns;
+    std::vector<int64_t> reset_step_ns;
+    normal_step_ns.reserve(num_steps);
+
+    double step_seconds = 0.0;
+    std::chrono::steady_clock::time_point loop_start;
+
+    for (int64_t i = 0; i < num_warmup_steps + num_steps; i++) {
+        if (i == num_warmup_steps) {
+            loop_start = std::chrono::steady_clock::now();
+        }
+
+        if (rand_actions) {
+            mgr.setActions(
+                action_sets.data() + (i % num_action_sets) * num_agents,
+                num_agents);
+        }
+
+        bool reset_step = reset_interval > 0 && (i + 1) % reset_interval == 0;
+        if (reset_step) {
+            mgr.triggerResets(all_worlds.data(), all_worlds.size());
+        }
+
+        auto step_start = std::chrono::steady_clock::now();
+        mgr.step();
+        auto step_end = std::chrono::steady_clock::now();
+
+        if (i < num_warmup_steps) {
+            continue;
+        }
+
+        std::chrono::duration<double> step_time = step_end - step_start;
+        step_seconds += step_time.count();
+
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            step_end - step_start).count();
+        (reset_step ? reset_step_ns : normal_step_ns).push_back(ns);
+    }
+
+    std::chrono::duration<double> wall_time =
+        std::chrono::steady_clock::now() - loop_start;
+
+    return BenchmarkRun {
+        .numWorlds = num_worlds,
+        .numWorkers = num_workers,
+        .stepSeconds = step_seconds,
+        .wallSeconds = wall_time.count(),
+        .normalSteps = computeLatencyStats(normal_step_ns),
+        .resetSteps = computeLatencyStats(reset_step_ns),
+    };
+}
+
+static void writeJSONString(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (const char *c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', f);
+            fputc(*c, f);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(f, "\\u%04x", (unsigned char)*c);
+        } else {
+            fputc(*c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void writeJSONLatencyStats(FILE *f, const char *name,
+                                  const StepLatencyStats &stats)
+{
+    fprintf(f, "      \"%s\": {\"count\": %lld, \"mean_us\": %.3f, "
+            "\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+            "\"max_us\": %.3f}", name, (long long)stats.count, stats.mean,
+            stats.p50, stats.p90, stats.p99, stats.max);
+}
+
+// Writes the results of a benchmark sweep as JSON, so throughput can be
+// compared between versions
+static bool writeBenchmarkJSON(const char *path,
+                               int argc, char *argv[],
+                               const char *exec_mode,
+                               int64_t num_warmup_steps,
+                               int64_t num_steps,
+                               int64_t reset_interval,
+                               const std::vector<BenchmarkRun> &runs)
+{
+    FILE *f = fopen(path, "w");
+    if (f == nullptr) {
+        return false;
+    }
+
+    std::string command;
+    for (int i = 0; i < argc; i++) {
+        if (i > 0) {
+            command += ' ';
+        }
+        command += argv[i];
+    }
+
+    fprintf(f, "{\n  \"command\": ");
+    writeJSONString(f, command.c_str());
+    fprintf(f, ",\n  \"exec_mode\": \"%s\",\n", exec_mode);
+    fprintf(f, "  \"warmup_steps\": %lld,\n", (long long)num_warmup_steps);
+    fprintf(f, "  \"num_steps\": %lld,\n", (long long)num_steps);
+    fprintf(f, "  \"reset_interval\": %lld,\n", (long long)reset_interval);
+    fprintf(f, "  \"runs\": [\n");
+
+    for (size_t i = 0; i < runs.size(); i++) {
+        const BenchmarkRun &run = runs[i];
+        double world_steps = (double)run.numWorlds * (double)num_steps;
+
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"num_worlds\": %u,\n", run.numWorlds);
+        fprintf(f, "      \"num_workers\": %u,\n", run.numWorkers);
+        fprintf(f, "      \"step_seconds\": %.6f,\n", run.stepSeconds);
+        fprintf(f, "      \"wall_seconds\": %.6f,\n", run.wallSeconds);
+        fprintf(f, "      \"world_steps_per_second\": %.1f,\n",
+                world_steps / run.stepSeconds);
+        writeJSONLatencyStats(f, "normal_steps", run.normalSteps);
+        fprintf(f, ",\n");
+        writeJSONLatencyStats(f, "reset_steps", run.resetSteps);
+        fprintf(f, "\n    }%s\n", i + 1 < runs.size() ? "," : "");
+    }
+
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     using namespace madEscape;
 
     if (argc < 4) {
-        fprintf(stderr, "%s TYPE NUM_WORLDS NUM_STEPS [--rand-actions]\n", argv[0]);
+        fprintf(stderr, "%s TYPE NUM_WORLDS NUM_STEPS [--rand-actions] "
+                "[--reset-every-step] [--no-entity-pool] "
+                "[--level-bank PATH] [--raycast-scene] [--prefetch-levels] "
+                "[--scalar-obs] [--planar-lidar] [--task-timings] "
+                "[--bench JSON_PATH [--bench-worlds N,...] "
+                "[--bench-workers N,...] [--warmup-steps N] "
+                "[--reset-interval N]] [--num-workers N] [--numa-node N] "
+                "[--pin-workers]\n", argv[0]);
         return -1;
     }
     std::string type(argv[1]);
@@ -46,29 +309,158 @@ int main(int argc, char *argv[])
     uint64_t num_worlds = std::stoul(argv[2]);
     uint64_t num_steps = std::stoul(argv[3]);
 
-    HeapArray<int32_t> action_store(
-        num_worlds * 2 * num_steps * 3);
-
     bool rand_actions = false;
-    if (argc >= 5) {
-        if (std::string(argv[4]) == "--rand-actions") {
+    // --reset-every-step forces every world to regenerate its level on every
+    // step. Combined with --no-entity-pool this compares the pooled reset
+    // path against destroying and recreating the level entities.
+    bool reset_every_step = false;
+    bool use_entity_pool = true;
+    const char *level_bank_path = nullptr;
+    bool use_raycast_scene = false;
+    bool prefetch_levels = false;
+    bool simd_obs = true;
+    bool planar_lidar = false;
+    bool task_timings = false;
+    // --bench replaces the single timed run by a sweep over world and
+    // worker counts with per-step latencies, written to a JSON file.
+    // NUM_STEPS steps are timed after --warmup-steps untimed ones.
+    const char *bench_path = nullptr;
+    std::vector<uint32_t> bench_worlds;
+    std::vector<uint32_t> bench_workers;
+    int64_t warmup_steps = 100;
+    int64_t reset_interval = consts::episodeLen;
+    uint32_t num_workers = 0;
+    int32_t numa_node = -1;
+    bool pin_workers = false;
+    for (int i = 4; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--rand-actions") {
             rand_actions = true;
+        } else if (arg == "--reset-every-step") {
+            reset_every_step = true;
+        } else if (arg == "--no-entity-pool") {
+            use_entity_pool = false;
+        } else if (arg == "--level-bank" && i + 1 < argc) {
+            level_bank_path = argv[++i];
+        } else if (arg == "--raycast-scene") {
+            use_raycast_scene = true;
+        } else if (arg == "--prefetch-levels") {
+            prefetch_levels = true;
+        } else if (arg == "--scalar-obs") {
+            simd_obs = false;
+        } else if (arg == "--planar-lidar") {
+            planar_lidar = true;
+        } else if (arg == "--task-timings") {
+            task_timings = true;
+        } else if (arg == "--bench" && i + 1 < argc) {
+            bench_path = argv[++i];
+        } else if (arg == "--bench-worlds" && i + 1 < argc) {
+            if (!parseCountList(argv[++i], bench_worlds)) {
+                fprintf(stderr, "Invalid --bench-worlds list %s\n", argv[i]);
+                return -1;
+            }
+        } else if (arg == "--bench-workers" && i + 1 < argc) {
+            if (!parseCountList(argv[++i], bench_workers)) {
+                fprintf(stderr, "Invalid --bench-workers list %s\n",
+                        argv[i]);
+                return -1;
+            }
+        } else if (arg == "--warmup-steps" && i + 1 < argc) {
+            warmup_steps = std::stol(argv[++i]);
+        } else if (arg == "--reset-interval" && i + 1 < argc) {
+            reset_interval = std::stol(argv[++i]);
+        } else if (arg == "--num-workers" && i + 1 < argc) {
+            num_workers = (uint32_t)std::stoul(argv[++i]);
+        } else if (arg == "--numa-node" && i + 1 < argc) {
+            numa_node = (int32_t)std::stol(argv[++i]);
+        } else if (arg == "--pin-workers") {
+            pin_workers = true;
+        } else {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return -1;
         }
     }
 
-    Manager mgr({
+    Manager::Config mgr_cfg {
         .execMode = exec_mode,
         .gpuID = 0,
         .numWorlds = (uint32_t)num_worlds,
         .randSeed = 5,
         .autoReset = false,
         .enableBatchRenderer = false,
-    });
+        .useEntityPool = use_entity_pool,
+        .levelBankPath = level_bank_path,
+        .useRaycastScene = use_raycast_scene,
+        .prefetchLevels = prefetch_levels,
+        .numWorkers = num_workers,
+        .numaNode = numa_node,
+        .pinWorkers = pin_workers,
+        .simdObservations = simd_obs,
+        .planarLidar = planar_lidar,
+        .taskTimings = task_timings,
+    };
+
+    if (bench_path != nullptr) {
+        // Throughput is reported per timed step
+        if (num_steps == 0) {
+            fprintf(stderr, "--bench needs NUM_STEPS >= 1\n");
+            return -1;
+        }
+
+        if (bench_worlds.empty()) {
+            bench_worlds.push_back((uint32_t)num_worlds);
+        }
+        if (bench_workers.empty()) {
+            bench_workers.push_back(num_workers);
+        }
+        if (reset_every_step) {
+            reset_interval = 1;
+        }
+
+        std::vector<BenchmarkRun> runs;
+        for (uint32_t bench_num_worlds : bench_worlds) {
+            for (uint32_t bench_num_workers : bench_workers) {
+                BenchmarkRun run = runBenchmark(mgr_cfg, bench_num_worlds,
+                    bench_num_workers, warmup_steps, num_steps,
+                    reset_interval, rand_actions);
+
+                printf("%u worlds, %u workers: %.0f steps/s, "
+                       "step p50 %.1f us p99 %.1f us, "
+                       "reset step p50 %.1f us p99 %.1f us\n",
+                       run.numWorlds, run.numWorkers,
+                       (double)run.numWorlds * (double)num_steps /
+                           run.stepSeconds,
+                       run.normalSteps.p50, run.normalSteps.p99,
+                       run.resetSteps.p50, run.resetSteps.p99);
+
+                runs.push_back(run);
+            }
+        }
+
+        if (!writeBenchmarkJSON(bench_path, argc, argv, type.c_str(),
+                warmup_steps, num_steps, reset_interval, runs)) {
+            fprintf(stderr, "Failed to write %s\n", bench_path);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    Manager mgr(mgr_cfg);
+
+    HeapArray<int32_t> action_store(
+        num_worlds * 2 * num_steps * 3);
 
     std::random_device rd;
     std::mt19937 rand_gen(rd());
     std::uniform_int_distribution<int32_t> act_rand(0, 4);
 
+    HeapArray<Action> step_actions(num_worlds * 2);
+    HeapArray<int32_t> all_worlds(num_worlds);
+    for (CountT j = 0; j < (CountT)num_worlds; j++) {
+        all_worlds[j] = (int32_t)j;
+    }
+
     auto start = std::chrono::system_clock::now();
 
     for (CountT i = 0; i < (CountT)num_steps; i++) {
@@ -79,7 +471,12 @@ int main(int argc, char *argv[])
                     int32_t y = act_rand(rand_gen);
                     int32_t r = act_rand(rand_gen);
 
-                    mgr.setAction(j, k, x, y, r, 0);
+                    step_actions[j * 2 + k] = Action {
+                        .moveAmount = x,
+                        .moveAngle = y,
+                        .rotate = r,
+                        .grab = 0,
+                    };
                     
                     int64_t base_idx = j * num_steps * 2 * 3 + i * 2 * 3 + k * 3;
                     action_store[base_idx] = x;
@@ -87,7 +484,14 @@ int main(int argc, char *argv[])
                     action_store[base_idx + 2] = r;
                 }
             }
+
+            mgr.setActions(step_actions.data(), step_actions.size());
+        }
+
+        if (reset_every_step) {
+            mgr.triggerResets(all_worlds.data(), all_worlds.size());
         }
+
         mgr.step();
     }
 
@@ -96,4 +500,8 @@ int main(int argc, char *argv[])
 
     float fps = (double)num_steps * (double)num_worlds / elapsed.count();
     printf("FPS %f\n", fps);
+
+    if (task_timings) {
+        mgr.printTaskTimings();
+    }
 }
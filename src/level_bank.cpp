@@ -0,0 +1,137 @@
+#include "level_bank.hpp"
+
+#include <madrona/crash.hpp>
+
+#include <cstdlib>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace madEscape {
+
+static void validateHeader(const char *path,
+                           const LevelBankHeader &hdr,
+                           size_t num_file_bytes)
+{
+    if (hdr.magic != levelBankMagic) {
+        FATAL("%s is not a level bank", path);
+    }
+
+    if (hdr.version != levelBankVersion) {
+        FATAL("%s: unsupported level bank version %u", path, hdr.version);
+    }
+
+    if (hdr.layoutBytes != sizeof(LevelLayout)) {
+        FATAL("%s: level layout size mismatch (%u vs %u), "
+              "regenerate the level bank", path, hdr.layoutBytes,
+              (uint32_t)sizeof(LevelLayout));
+    }
+
+    if (hdr.numLevels == 0 || hdr.numLevels > (uint32_t)INT32_MAX) {
+        FATAL("%s: invalid number of levels %u", path, hdr.numLevels);
+    }
+
+    size_t expected_bytes =
+        sizeof(LevelBankHeader) + sizeof(LevelLayout) * hdr.numLevels;
+    if (num_file_bytes < expected_bytes) {
+        FATAL("%s: truncated level bank", path);
+    }
+}
+
+LevelBank LevelBank::load(const char *path)
+{
+#if !defined(_WIN32)
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        FATAL("Failed to open level bank %s", path);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+            (size_t)file_stat.st_size < sizeof(LevelBankHeader)) {
+        FATAL("Failed to read level bank %s", path);
+    }
+
+    size_t num_bytes = (size_t)file_stat.st_size;
+    void *data = mmap(nullptr, num_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        FATAL("Failed to map level bank %s", path);
+    }
+
+    LevelBank bank(data, num_bytes, true);
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        FATAL("Failed to open level bank %s", path);
+    }
+
+    size_t num_bytes = (size_t)file.tellg();
+    if (num_bytes < sizeof(LevelBankHeader)) {
+        FATAL("Failed to read level bank %s", path);
+    }
+
+    void *data = malloc(num_bytes);
+    file.seekg(0);
+    file.read((char *)data, num_bytes);
+
+    if (!file || (size_t)file.gcount() != num_bytes) {
+        free(data);
+        FATAL("Failed to read level bank %s", path);
+    }
+
+    LevelBank bank(data, num_bytes, false);
+#endif
+
+    const LevelBankHeader &hdr = *(const LevelBankHeader *)data;
+    validateHeader(path, hdr, num_bytes);
+
+    bank.levels_ = (const LevelLayout *)(
+        (const char *)data + sizeof(LevelBankHeader));
+    bank.numLevels_ = hdr.numLevels;
+
+    return bank;
+}
+
+LevelBank::LevelBank(void *data, size_t num_bytes, bool mapped)
+    : data_(data),
+      numBytes_(num_bytes),
+      mapped_(mapped),
+      levels_(nullptr),
+      numLevels_(0)
+{}
+
+LevelBank::LevelBank(LevelBank &&o)
+    : data_(o.data_),
+      numBytes_(o.numBytes_),
+      mapped_(o.mapped_),
+      levels_(o.levels_),
+      numLevels_(o.numLevels_)
+{
+    o.data_ = nullptr;
+}
+
+LevelBank::~LevelBank()
+{
+    if (data_ == nullptr) {
+        return;
+    }
+
+#if !defined(_WIN32)
+    if (mapped_) {
+        munmap(data_, numBytes_);
+        return;
+    }
+#endif
+
+    free(data_);
+}
+
+}
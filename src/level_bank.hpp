@@ -0,0 +1,63 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstddef>
+
+namespace madEscape {
+
+// A level bank is a flat binary file of precomputed LevelLayouts, written
+// offline by level_bank_gen (src/level_bank_gen.cpp):
+//
+//   LevelBankHeader | LevelLayout[numLevels]
+//
+// Layouts are stored in their in-memory representation, so a bank is only
+// valid for builds with the same consts.hpp (checked via layoutBytes) and
+// the same endianness.
+struct LevelBankHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t layoutBytes;
+    uint32_t numLevels;
+    // Seed the bank was generated from, informational only
+    uint32_t randSeed;
+    uint32_t pad[3];
+};
+
+inline constexpr uint32_t levelBankMagic = 0x4b4e424c; // "LBNK"
+inline constexpr uint32_t levelBankVersion = 1;
+
+// Read-only view of a level bank file. The file is memory mapped where
+// supported, so opening even very large banks is cheap and only the pages
+// for levels that are actually used get read from disk.
+class LevelBank {
+public:
+    // Exits with an error if the file can't be read or isn't a level bank
+    // compatible with this build.
+    static LevelBank load(const char *path);
+
+    LevelBank(LevelBank &&o);
+    ~LevelBank();
+
+    LevelBank(const LevelBank &) = delete;
+    LevelBank & operator=(const LevelBank &) = delete;
+    LevelBank & operator=(LevelBank &&) = delete;
+
+    inline const LevelLayout * levels() const { return levels_; }
+    inline uint32_t numLevels() const { return numLevels_; }
+    inline size_t numLevelBytes() const
+    {
+        return sizeof(LevelLayout) * numLevels_;
+    }
+
+private:
+    LevelBank(void *data, size_t num_bytes, bool mapped);
+
+    void *data_;
+    size_t numBytes_;
+    bool mapped_;
+    const LevelLayout *levels_;
+    uint32_t numLevels_;
+};
+
+}
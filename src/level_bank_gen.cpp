@@ -0,0 +1,80 @@
+#include "level_bank.hpp"
+#include "level_gen.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <madrona/heap_array.hpp>
+
+using namespace madrona;
+
+// Writes NUM_LEVELS layouts to OUT_PATH. Level i is sampled from the same
+// random key the simulator would use for world 0's i-th episode with the
+// given seed, so bank levels match levels generated on the fly.
+int main(int argc, char *argv[])
+{
+    using namespace madEscape;
+
+    if (argc < 3) {
+        fprintf(stderr, "%s OUT_PATH NUM_LEVELS [SEED]\n", argv[0]);
+        return -1;
+    }
+
+    uint64_t num_levels = std::stoul(argv[2]);
+    if (num_levels == 0 || num_levels > (uint64_t)INT32_MAX) {
+        fprintf(stderr, "NUM_LEVELS must be in [1, %d]\n", INT32_MAX);
+        return -1;
+    }
+
+    uint32_t seed = 5;
+    if (argc > 3) {
+        seed = (uint32_t)std::stoul(argv[3]);
+    }
+
+    std::ofstream out(argv[1], std::ios::binary);
+    if (!out.is_open()) {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return -1;
+    }
+
+    LevelBankHeader hdr {
+        .magic = levelBankMagic,
+        .version = levelBankVersion,
+        .layoutBytes = (uint32_t)sizeof(LevelLayout),
+        .numLevels = (uint32_t)num_levels,
+        .randSeed = seed,
+        .pad = {},
+    };
+    out.write((const char *)&hdr, sizeof(LevelBankHeader));
+
+    RandKey init_key = rand::initKey(seed);
+
+    // Generate in chunks to keep memory usage flat for very large banks
+    constexpr uint64_t chunk_size = 64 * 1024;
+    HeapArray<LevelLayout> chunk(chunk_size);
+
+    for (uint64_t base = 0; base < num_levels; base += chunk_size) {
+        uint64_t num_chunk_levels = std::min(chunk_size, num_levels - base);
+
+        for (uint64_t i = 0; i < num_chunk_levels; i++) {
+            RNG rng(rand::split_i(init_key, uint32_t(base + i), 0));
+            sampleLevelLayout(rng, chunk[i]);
+        }
+
+        out.write((const char *)chunk.data(),
+                  sizeof(LevelLayout) * num_chunk_levels);
+    }
+
+    if (!out.good()) {
+        fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return -1;
+    }
+
+    printf("Wrote %lu levels (%lu bytes each) to %s\n",
+           (unsigned long)num_levels, (unsigned long)sizeof(LevelLayout),
+           argv[1]);
+
+    return 0;
+}
@@ -10,6 +10,10 @@ namespace consts {
 
 inline constexpr float doorWidth = consts::worldWidth / 3.f;
 
+// Height that unused pooled entities are parked at, far below the floor
+// so they are never hit by lidar, grab rays or button checks.
+inline constexpr float parkedEntityZ = -100.f;
+
 }
 
 enum class RoomType : uint32_t {
@@ -20,14 +24,14 @@ enum class RoomType : uint32_t {
     NumTypes,
 };
 
-static inline float randInRangeCentered(Engine &ctx, float range)
+static inline float randInRangeCentered(RNG &rng, float range)
 {
-    return ctx.data().rng.sampleUniform() * range - range / 2.f;
+    return rng.sampleUniform() * range - range / 2.f;
 }
 
-static inline float randBetween(Engine &ctx, float min, float max)
+static inline float randBetween(RNG &rng, float min, float max)
 {
-    return ctx.data().rng.sampleUniform() * (max - min) + min;
+    return rng.sampleUniform() * (max - min) + min;
 }
 
 // Initialize the basic components needed for physics rigid body entities
@@ -71,6 +75,73 @@ static void registerRigidBodyEntity(
         PhysicsSystem::registerEntity(ctx, e, obj_id);
 }
 
+// Level entities either come out of the per-world LevelEntityPool or are
+// freshly created, in which case cleanupWorld destroys them at the end of
+// the episode. Walls and doors have a fixed slot per room, cubes and buttons
+// are taken from the pool in order.
+static Entity makeWallEntity(Engine &ctx, CountT room_idx, CountT side)
+{
+    if (ctx.data().useEntityPool) {
+        return ctx.data().entityPool.walls[room_idx][side];
+    }
+
+    return ctx.makeRenderableEntity<PhysicsEntity>();
+}
+
+static Entity makeDoorEntity(Engine &ctx, CountT room_idx)
+{
+    if (ctx.data().useEntityPool) {
+        return ctx.data().entityPool.doors[room_idx];
+    }
+
+    return ctx.makeRenderableEntity<DoorEntity>();
+}
+
+static Entity makeCubeEntity(Engine &ctx)
+{
+    if (ctx.data().useEntityPool) {
+        LevelEntityPool &pool = ctx.data().entityPool;
+        return pool.cubes[pool.numCubesUsed++];
+    }
+
+    return ctx.makeRenderableEntity<PhysicsEntity>();
+}
+
+static Entity makeButtonEntity(Engine &ctx)
+{
+    if (ctx.data().useEntityPool) {
+        LevelEntityPool &pool = ctx.data().entityPool;
+        return pool.buttons[pool.numButtonsUsed++];
+    }
+
+    return ctx.makeRenderableEntity<ButtonEntity>();
+}
+
+// Allocates every entity a level can need up front. Components are left
+// uninitialized here, level generation sets them up on each reset.
+static void createEntityPool(Engine &ctx)
+{
+    LevelEntityPool &pool = ctx.data().entityPool;
+
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        pool.walls[i][0] = ctx.makeRenderableEntity<PhysicsEntity>();
+        pool.walls[i][1] = ctx.makeRenderableEntity<PhysicsEntity>();
+        pool.doors[i] = ctx.makeRenderableEntity<DoorEntity>();
+    }
+
+    for (CountT i = 0; i < consts::numRooms * consts::maxCubesPerRoom; i++) {
+        pool.cubes[i] = ctx.makeRenderableEntity<PhysicsEntity>();
+    }
+
+    for (CountT i = 0; i < consts::numRooms * consts::maxButtonsPerRoom;
+         i++) {
+        pool.buttons[i] = ctx.makeRenderableEntity<ButtonEntity>();
+    }
+
+    pool.numCubesUsed = 0;
+    pool.numButtonsUsed = 0;
+}
+
 // Creates floor, outer walls, and agent entities.
 // All these entities persist across all episodes.
 void createPersistentEntities(Engine &ctx)
@@ -167,6 +238,7 @@ void createPersistentEntities(Engine &ctx)
         ctx.get<ResponseType>(agent) = ResponseType::Dynamic;
         ctx.get<GrabState>(agent).constraintEntity = Entity::none();
         ctx.get<EntityType>(agent) = EntityType::Agent;
+        ctx.get<AgentID>(agent).idx = (int32_t)i;
     }
 
     // Populate OtherAgents component, which maintains a reference to the
@@ -185,12 +257,16 @@ void createPersistentEntities(Engine &ctx)
             other_agents.e[out_idx++] = other_agent;
         }
     }
+
+    if (ctx.data().useEntityPool) {
+        createEntityPool(ctx);
+    }
 }
 
 // Although agents and walls persist between episodes, we still need to
 // re-register them with the broadphase system and, in the case of the agents,
 // reset their positions.
-static void resetPersistentEntities(Engine &ctx)
+static void resetPersistentEntities(Engine &ctx, const LevelLayout &layout)
 {
     registerRigidBodyEntity(ctx, ctx.data().floorPlane, SimObject::Plane);
 
@@ -203,24 +279,15 @@ static void resetPersistentEntities(Engine &ctx)
          Entity agent_entity = ctx.data().agents[i];
          registerRigidBodyEntity(ctx, agent_entity, SimObject::Agent);
 
-         // Place the agents near the starting wall
          Vector3 pos {
-             randInRangeCentered(ctx, 
-                 consts::worldWidth / 2.f - 2.5f * consts::agentRadius),
-             randBetween(ctx, consts::agentRadius * 1.1f,  2.f),
+             layout.agentPositions[i].x,
+             layout.agentPositions[i].y,
              0.f,
          };
 
-         if (i % 2 == 0) {
-             pos.x += consts::worldWidth / 4.f;
-         } else {
-             pos.x -= consts::worldWidth / 4.f;
-         }
-
          ctx.get<Position>(agent_entity) = pos;
          ctx.get<Rotation>(agent_entity) = Quat::angleAxis(
-             randInRangeCentered(ctx, math::pi / 4.f),
-             math::up);
+             layout.agentYaws[i], math::up);
 
          auto &grab_state = ctx.get<GrabState>(agent_entity);
          if (grab_state.constraintEntity != Entity::none()) {
@@ -250,17 +317,15 @@ static void resetPersistentEntities(Engine &ctx)
 // Builds the two walls & door that block the end of the challenge room
 static void makeEndWall(Engine &ctx,
                         Room &room,
-                        CountT room_idx)
+                        CountT room_idx,
+                        float door_center)
 {
     float y_pos = consts::roomLength * (room_idx + 1) -
         consts::wallWidth / 2.f;
 
-    // Quarter door of buffer on both sides, place door and then build walls
-    // up to the door gap on both sides
-    float door_center = randBetween(ctx, 0.75f * consts::doorWidth, 
-        consts::worldWidth - 0.75f * consts::doorWidth);
+    // Place door and then build walls up to the door gap on both sides
     float left_len = door_center - 0.5f * consts::doorWidth;
-    Entity left_wall = ctx.makeRenderableEntity<PhysicsEntity>();
+    Entity left_wall = makeWallEntity(ctx, room_idx, 0);
     setupRigidBodyEntity(
         ctx,
         left_wall,
@@ -282,7 +347,7 @@ static void makeEndWall(Engine &ctx,
 
     float right_len =
         consts::worldWidth - door_center - 0.5f * consts::doorWidth;
-    Entity right_wall = ctx.makeRenderableEntity<PhysicsEntity>();
+    Entity right_wall = makeWallEntity(ctx, room_idx, 1);
     setupRigidBodyEntity(
         ctx,
         right_wall,
@@ -302,7 +367,7 @@ static void makeEndWall(Engine &ctx,
         });
     registerRigidBodyEntity(ctx, right_wall, SimObject::Wall);
 
-    Entity door = ctx.makeRenderableEntity<DoorEntity>();
+    Entity door = makeDoorEntity(ctx, room_idx);
     setupRigidBodyEntity(
         ctx,
         door,
@@ -332,7 +397,7 @@ static Entity makeButton(Engine &ctx,
                          float button_x,
                          float button_y)
 {
-    Entity button = ctx.makeRenderableEntity<ButtonEntity>();
+    Entity button = makeButtonEntity(ctx);
     ctx.get<Position>(button) = Vector3 {
         button_x,
         button_y,
@@ -356,7 +421,7 @@ static Entity makeCube(Engine &ctx,
                        float cube_y,
                        float scale = 1.f)
 {
-    Entity cube = ctx.makeRenderableEntity<PhysicsEntity>();
+    Entity cube = makeCubeEntity(ctx);
     setupRigidBodyEntity(
         ctx,
         cube,
@@ -480,223 +545,267 @@ static Entity makeBasketballCourt(Engine &ctx,
 
 
 
+// Links the door to the first num_buttons entities of its room, which
+// makeRoom fills with the room's buttons.
 static void setupDoor(Engine &ctx,
                       Entity door,
-                      Span<const Entity> buttons,
+                      CountT room_idx,
+                      CountT num_buttons,
                       bool is_persistent)
 {
     DoorProperties &props = ctx.get<DoorProperties>(door);
 
-    for (CountT i = 0; i < buttons.size(); i++) {
-        props.buttons[i] = buttons[i];
+    props.buttonMask = 0;
+    for (CountT i = 0; i < num_buttons; i++) {
+        props.buttonMask |= buttonBit(room_idx, i);
     }
-    props.numButtons = (int32_t)buttons.size();
     props.isPersistent = is_persistent;
 }
 
 // A room with a single button that needs to be pressed, the door stays open.
-static CountT makeSingleButtonRoom(Engine &ctx,
-                                   Room &room,
+static void sampleSingleButtonRoom(RNG &rng,
+                                   RoomLayout &room,
                                    float y_min,
                                    float y_max)
 {
-    float button_x = randInRangeCentered(ctx,
+    float button_x = randInRangeCentered(rng,
         consts::worldWidth / 2.f - consts::buttonWidth);
-    float button_y = randBetween(ctx, y_min + consts::roomLength / 4.f,
+    float button_y = randBetween(rng, y_min + consts::roomLength / 4.f,
         y_max - consts::wallWidth - consts::buttonWidth / 2.f);
 
-    Entity button = makeButton(ctx, button_x, button_y);
-
-    setupDoor(ctx, room.door, { button }, true);
-
-    room.entities[0] = button;
-
-    return 1;
+    room.buttons[0] = { button_x, button_y };
 }
 
 // A room with two buttons that need to be pressed simultaneously,
 // the door stays open.
-static CountT makeDoubleButtonRoom(Engine &ctx,
-                                   Room &room,
+static void sampleDoubleButtonRoom(RNG &rng,
+                                   RoomLayout &room,
                                    float y_min,
                                    float y_max)
 {
-    float a_x = randBetween(ctx,
+    float a_x = randBetween(rng,
         -consts::worldWidth / 2.f + consts::buttonWidth,
         -consts::buttonWidth);
 
-    float a_y = randBetween(ctx,
+    float a_y = randBetween(rng,
         y_min + consts::roomLength / 4.f,
         y_max - consts::wallWidth - consts::buttonWidth / 2.f);
 
-    Entity a = makeButton(ctx, a_x, a_y);
+    room.buttons[0] = { a_x, a_y };
 
-    float b_x = randBetween(ctx,
+    float b_x = randBetween(rng,
         consts::buttonWidth,
         consts::worldWidth / 2.f - consts::buttonWidth);
 
-    float b_y = randBetween(ctx,
+    float b_y = randBetween(rng,
         y_min + consts::roomLength / 4.f,
         y_max - consts::wallWidth - consts::buttonWidth / 2.f);
 
-    Entity b = makeButton(ctx, b_x, b_y);
-
-    setupDoor(ctx, room.door, { a, b }, true);
-
-    room.entities[0] = a;
-    room.entities[1] = b;
-
-    return 2;
+    room.buttons[1] = { b_x, b_y };
 }
 
 // This room has 3 cubes blocking the exit door as well as two buttons.
 // The agents either need to pull the middle cube out of the way and
 // open the door or open the door with the buttons and push the cubes
 // into the next room.
-static CountT makeCubeBlockingRoom(Engine &ctx,
-                                   Room &room,
+static void sampleCubeBlockingRoom(RNG &rng,
+                                   RoomLayout &room,
                                    float y_min,
                                    float y_max)
 {
-    float button_a_x = randBetween(ctx,
+    float button_a_x = randBetween(rng,
         -consts::worldWidth / 2.f + consts::buttonWidth,
         -consts::buttonWidth - consts::worldWidth / 4.f);
 
-    float button_a_y = randBetween(ctx,
+    float button_a_y = randBetween(rng,
         y_min + consts::buttonWidth,
         y_max - consts::roomLength / 4.f);
 
-    Entity button_a = makeButton(ctx, button_a_x, button_a_y);
+    room.buttons[0] = { button_a_x, button_a_y };
 
-    float button_b_x = randBetween(ctx,
+    float button_b_x = randBetween(rng,
         consts::buttonWidth + consts::worldWidth / 4.f,
         consts::worldWidth / 2.f - consts::buttonWidth);
 
-    float button_b_y = randBetween(ctx,
+    float button_b_y = randBetween(rng,
         y_min + consts::buttonWidth,
         y_max - consts::roomLength / 4.f);
 
-    Entity button_b = makeButton(ctx, button_b_x, button_b_y);
-
-    setupDoor(ctx, room.door, { button_a, button_b }, true);
-
-    Vector3 door_pos = ctx.get<Position>(room.door);
-
-    float cube_a_x = door_pos.x - 3.f;
-    float cube_a_y = door_pos.y - 2.f;
-
-    Entity cube_a = makeCube(ctx, cube_a_x, cube_a_y, 1.5f);
-
-    float cube_b_x = door_pos.x;
-    float cube_b_y = door_pos.y - 2.f;
+    room.buttons[1] = { button_b_x, button_b_y };
 
-    Entity cube_b = makeCube(ctx, cube_b_x, cube_b_y, 1.5f);
+    // Same door position makeEndWall computes from doorCenter
+    float door_x = room.doorCenter - consts::worldWidth / 2.f;
+    float door_y = y_max - consts::wallWidth / 2.f;
 
-    float cube_c_x = door_pos.x + 3.f;
-    float cube_c_y = door_pos.y - 2.f;
-
-    Entity cube_c = makeCube(ctx, cube_c_x, cube_c_y, 1.5f);
-
-    room.entities[0] = button_a;
-    room.entities[1] = button_b;
-    room.entities[2] = cube_a;
-    room.entities[3] = cube_b;
-    room.entities[4] = cube_c;
-
-    return 5;
+    room.cubes[0] = { door_x - 3.f, door_y - 2.f };
+    room.cubes[1] = { door_x, door_y - 2.f };
+    room.cubes[2] = { door_x + 3.f, door_y - 2.f };
 }
 
 // This room has 2 buttons and 2 cubes. The buttons need to remain pressed
 // for the door to stay open. To progress, the agents must push at least one
 // cube onto one of the buttons, or more optimally, both.
-static CountT makeCubeButtonsRoom(Engine &ctx,
-                                  Room &room,
+static void sampleCubeButtonsRoom(RNG &rng,
+                                  RoomLayout &room,
                                   float y_min,
                                   float y_max)
 {
-    float button_a_x = randBetween(ctx,
+    float button_a_x = randBetween(rng,
         -consts::worldWidth / 2.f + consts::buttonWidth,
         -consts::buttonWidth - consts::worldWidth / 4.f);
 
-    float button_a_y = randBetween(ctx,
+    float button_a_y = randBetween(rng,
         y_min + consts::buttonWidth,
         y_max - consts::roomLength / 4.f);
 
-    Entity button_a = makeButton(ctx, button_a_x, button_a_y);
+    room.buttons[0] = { button_a_x, button_a_y };
 
-    float button_b_x = randBetween(ctx,
+    float button_b_x = randBetween(rng,
         consts::buttonWidth + consts::worldWidth / 4.f,
         consts::worldWidth / 2.f - consts::buttonWidth);
 
-    float button_b_y = randBetween(ctx,
+    float button_b_y = randBetween(rng,
         y_min + consts::buttonWidth,
         y_max - consts::roomLength / 4.f);
 
-    Entity button_b = makeButton(ctx, button_b_x, button_b_y);
-
-    setupDoor(ctx, room.door, { button_a, button_b }, false);
+    room.buttons[1] = { button_b_x, button_b_y };
 
-    float cube_a_x = randBetween(ctx,
+    float cube_a_x = randBetween(rng,
         -consts::worldWidth / 4.f,
         -1.5f);
 
-    float cube_a_y = randBetween(ctx,
+    float cube_a_y = randBetween(rng,
         y_min + 2.f,
         y_max - consts::wallWidth - 2.f);
 
-    Entity cube_a = makeCube(ctx, cube_a_x, cube_a_y, 1.5f);
+    room.cubes[0] = { cube_a_x, cube_a_y };
 
-    float cube_b_x = randBetween(ctx,
+    float cube_b_x = randBetween(rng,
         1.5f,
         consts::worldWidth / 4.f);
 
-    float cube_b_y = randBetween(ctx,
+    float cube_b_y = randBetween(rng,
         y_min + 2.f,
         y_max - consts::wallWidth - 2.f);
 
-    Entity cube_b = makeCube(ctx, cube_b_x, cube_b_y, 1.5f);
-
-    room.entities[0] = button_a;
-    room.entities[1] = button_b;
-    room.entities[2] = cube_a;
-    room.entities[3] = cube_b;
-
-    return 4;
+    room.cubes[1] = { cube_b_x, cube_b_y };
 }
 
-// Make the doors and separator walls at the end of the room
-// before delegating to specific code based on room_type.
-static void makeRoom(Engine &ctx,
-                     LevelState &level,
-                     CountT room_idx,
-                     RoomType room_type)
+// Samples the door position at the end of the room before delegating to
+// specific code based on room_type.
+static void sampleRoom(RNG &rng,
+                       RoomLayout &room,
+                       CountT room_idx,
+                       RoomType room_type)
 {
-    Room &room = level.rooms[room_idx];
-    makeEndWall(ctx, room, room_idx);
+    room.type = (uint32_t)room_type;
+
+    // Quarter door of buffer on both sides
+    room.doorCenter = randBetween(rng, 0.75f * consts::doorWidth, 
+        consts::worldWidth - 0.75f * consts::doorWidth);
 
     float room_y_min = room_idx * consts::roomLength;
     float room_y_max = (room_idx + 1) * consts::roomLength;
 
-    CountT num_room_entities;
     switch (room_type) {
     case RoomType::SingleButton: {
-        num_room_entities =
-            makeSingleButtonRoom(ctx, room, room_y_min, room_y_max);
+        sampleSingleButtonRoom(rng, room, room_y_min, room_y_max);
     } break;
     case RoomType::DoubleButton: {
-        num_room_entities =
-            makeDoubleButtonRoom(ctx, room, room_y_min, room_y_max);
+        sampleDoubleButtonRoom(rng, room, room_y_min, room_y_max);
     } break;
     case RoomType::CubeBlocking: {
-        num_room_entities =
-            makeCubeBlockingRoom(ctx, room, room_y_min, room_y_max);
+        sampleCubeBlockingRoom(rng, room, room_y_min, room_y_max);
     } break;
     case RoomType::CubeButtons: {
-        num_room_entities =
-            makeCubeButtonsRoom(ctx, room, room_y_min, room_y_max);
+        sampleCubeButtonsRoom(rng, room, room_y_min, room_y_max);
     } break;
     default: MADRONA_UNREACHABLE();
     }
+}
+
+void sampleLevelLayout(RNG &rng, LevelLayout &layout)
+{
+    layout = {};
+
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        // Place the agents near the starting wall
+        Vector2 pos {
+            randInRangeCentered(rng, 
+                consts::worldWidth / 2.f - 2.5f * consts::agentRadius),
+            randBetween(rng, consts::agentRadius * 1.1f,  2.f),
+        };
+
+        if (i % 2 == 0) {
+            pos.x += consts::worldWidth / 4.f;
+        } else {
+            pos.x -= consts::worldWidth / 4.f;
+        }
+
+        layout.agentPositions[i] = pos;
+        layout.agentYaws[i] = randInRangeCentered(rng, math::pi / 4.f);
+    }
+
+    // For training simplicity, define a fixed sequence of levels.
+    // sampleRoom(rng, layout.rooms[0], 0, RoomType::DoubleButton);
+    // sampleRoom(rng, layout.rooms[1], 1, RoomType::CubeBlocking);
+    // sampleRoom(rng, layout.rooms[2], 2, RoomType::CubeButtons);
+
+#if 1
+    // An alternative implementation could randomly select the type for each
+    // room rather than a fixed progression of challenge difficulty
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        RoomType room_type = (RoomType)(
+            rng.sampleI32(0, (uint32_t)RoomType::NumTypes));
+
+        sampleRoom(rng, layout.rooms[i], i, room_type);
+    }
+#endif
+}
+
+// Number of buttons and cubes each room type places, and whether its door
+// stays open once it has been opened.
+struct RoomTypeInfo {
+    CountT numButtons;
+    CountT numCubes;
+    bool persistentDoor;
+};
+
+static RoomTypeInfo getRoomTypeInfo(RoomType room_type)
+{
+    switch (room_type) {
+    case RoomType::SingleButton: return { 1, 0, true };
+    case RoomType::DoubleButton: return { 2, 0, true };
+    case RoomType::CubeBlocking: return { 2, 3, true };
+    case RoomType::CubeButtons: return { 2, 2, false };
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+// Make the doors and separator walls at the end of the room, followed by
+// the room's buttons and then its cubes.
+static void makeRoom(Engine &ctx,
+                     LevelState &level,
+                     CountT room_idx,
+                     const RoomLayout &layout)
+{
+    Room &room = level.rooms[room_idx];
+    makeEndWall(ctx, room, room_idx, layout.doorCenter);
+
+    RoomTypeInfo info = getRoomTypeInfo((RoomType)layout.type);
+
+    CountT num_room_entities = 0;
+    for (CountT i = 0; i < info.numButtons; i++) {
+        room.entities[num_room_entities++] = makeButton(ctx,
+            layout.buttons[i].x, layout.buttons[i].y);
+    }
+
+    setupDoor(ctx, room.door, room_idx, info.numButtons, info.persistentDoor);
+
+    for (CountT i = 0; i < info.numCubes; i++) {
+        room.entities[num_room_entities++] = makeCube(ctx,
+            layout.cubes[i].x, layout.cubes[i].y, 1.5f);
+    }
 
     // Need to set any extra entities to type none so random uninitialized data
     // from prior episodes isn't exported to pytorch as agent observations.
@@ -705,38 +814,118 @@ static void makeRoom(Engine &ctx,
     }
 }
 
-
-
-
-static void generateLevel(Engine &ctx)
+static void generateLevel(Engine &ctx, const LevelLayout &layout)
 {
     LevelState &level = ctx.singleton<LevelState>();
 
-    // For training simplicity, define a fixed sequence of levels.
-    // makeRoom(ctx, level, 0, RoomType::DoubleButton);
-    // makeRoom(ctx, level, 1, RoomType::CubeBlocking);
-    // makeRoom(ctx, level, 2, RoomType::CubeButtons);
     // makeBasketballHoop(ctx, 0.0f, consts::roomLength / 2.f);
     // makeBasketball(ctx, 0.0f, consts::roomLength / 2.f);
     // makeBasketballCourt(ctx, 0.0f, consts::roomLength / 2.f);   
 
-#if 1
-    // An alternative implementation could randomly select the type for each
-    // room rather than a fixed progression of challenge difficulty
     for (CountT i = 0; i < consts::numRooms; i++) {
-        RoomType room_type = (RoomType)(
-            ctx.data().rng.sampleI32(0, (uint32_t)RoomType::NumTypes));
+        makeRoom(ctx, level, i, layout.rooms[i]);
+    }
+
+    // The new doors haven't seen any button presses yet, and are closed
+    // at rest
+    ctx.singleton<ButtonPresses>().doorsEvaluated = ~0u;
+    ctx.singleton<MovingDoors>().mask = 0;
+}
+
+// Moves the pooled cubes and buttons the current level didn't ask for out
+// of the play area. Parked cubes are static so the solver ignores them, but
+// like every rigid body they still need to be registered with the broadphase.
+static void parkUnusedPoolEntities(Engine &ctx)
+{
+    LevelEntityPool &pool = ctx.data().entityPool;
+
+    for (CountT i = pool.numCubesUsed;
+         i < consts::numRooms * consts::maxCubesPerRoom; i++) {
+        Entity cube = pool.cubes[i];
+        setupRigidBodyEntity(
+            ctx,
+            cube,
+            Vector3 {
+                float(i) * 4.f,
+                -consts::worldWidth,
+                consts::parkedEntityZ,
+            },
+            Quat { 1, 0, 0, 0 },
+            SimObject::Cube,
+            EntityType::Cube,
+            ResponseType::Static);
+        registerRigidBodyEntity(ctx, cube, SimObject::Cube);
+    }
 
-        makeRoom(ctx, level, i, room_type);
+    for (CountT i = pool.numButtonsUsed;
+         i < consts::numRooms * consts::maxButtonsPerRoom; i++) {
+        Entity button = pool.buttons[i];
+        ctx.get<Position>(button) = Vector3 {
+            float(i) * 4.f,
+            -2.f * consts::worldWidth,
+            consts::parkedEntityZ,
+        };
+        ctx.get<ButtonState>(button).isPressed = false;
     }
-#endif
+}
+
+// Picks the level bank entry for this episode: the requested index if the
+// world has been pinned to one, otherwise a pseudo-random index drawn from
+// the episode's RNG (itself derived from the world ID and episode counter).
+// Requests outside the bank are ignored like -1, select.current tells which
+// level was picked instead.
+static const LevelLayout & selectBankLevel(Engine &ctx)
+{
+    LevelSelect &select = ctx.singleton<LevelSelect>();
+    uint32_t num_levels = ctx.data().numBankLevels;
+
+    int32_t level_idx;
+    if (select.requested >= 0 && (uint32_t)select.requested < num_levels) {
+        level_idx = select.requested;
+    } else {
+        level_idx = ctx.data().rng.sampleI32(0, num_levels);
+    }
+
+    select.current = level_idx;
+    return ctx.data().levelBank[level_idx];
 }
 
 // Randomly generate a new world for a training episode
 void generateWorld(Engine &ctx)
 {
-    resetPersistentEntities(ctx);
-    generateLevel(ctx);
+    // initWorld has already advanced curWorldEpisode past this episode
+    uint32_t episode = ctx.data().curWorldEpisode - 1;
+    LevelPrefetchSlot *prefetch = ctx.data().levelPrefetch;
+
+    LevelLayout sampled_layout;
+    const LevelLayout *layout;
+    if (ctx.data().levelBank != nullptr) {
+        layout = &selectBankLevel(ctx);
+    } else if (prefetch != nullptr &&
+               prefetch->readyEpisode.load_acquire() == episode) {
+        // The prefetch thread sampled this layout from the same random key
+        // as ctx.data().rng, so it is the level we would generate here.
+        layout = &prefetch->layout;
+    } else {
+        sampleLevelLayout(ctx.data().rng, sampled_layout);
+        layout = &sampled_layout;
+    }
+
+    resetPersistentEntities(ctx, *layout);
+    generateLevel(ctx, *layout);
+
+    // Done reading the slot, let the prefetch thread prepare the next one
+    if (prefetch != nullptr) {
+        prefetch->requestedEpisode.store_release(episode + 1);
+    }
+
+    if (ctx.data().useRaycastScene) {
+        buildRaycastScene(ctx);
+    }
+
+    if (ctx.data().useEntityPool) {
+        parkUnusedPoolEntities(ctx);
+    }
 }
 
 }
@@ -8,9 +8,16 @@ namespace madEscape {
 // all episodes.
 void createPersistentEntities(Engine &ctx);
 
+// Draws every random value needed for a level from rng (agent spawns, room
+// types, door positions, button & cube placement) without touching the ECS.
+// Given the same RNG state this produces the same level generateWorld would.
+// Also used offline to fill level banks (src/level_bank_gen.cpp).
+void sampleLevelLayout(madrona::RNG &rng, LevelLayout &layout);
+
 // Randomly generate a new world for a training episode
 // First, destroys any non-persistent state for the current world and then
-// generates a new play area.
+// generates a new play area, taking the layout from the level bank if one
+// was provided in Sim::Config.
 void generateWorld(Engine &ctx);
 
 }
@@ -0,0 +1,95 @@
+#include "level_prefetch.hpp"
+#include "level_gen.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace madEscape {
+
+using namespace madrona;
+
+// readyEpisode value for slots that don't hold a layout yet
+static constexpr uint32_t noEpisode = ~0u;
+
+LevelPrefetcher::LevelPrefetcher(uint32_t num_worlds, RandKey init_rand_key)
+    : numWorlds_(num_worlds),
+      initRandKey_(init_rand_key),
+      slots_((LevelPrefetchSlot *)malloc(
+          sizeof(LevelPrefetchSlot) * num_worlds)),
+      lock_(),
+      wakeCV_(),
+      wakePending_(true),
+      shutdown_(false),
+      worker_()
+{
+    for (uint32_t i = 0; i < num_worlds; i++) {
+        new (&slots_[i]) LevelPrefetchSlot {
+            AtomicU32(0),
+            AtomicU32(noEpisode),
+            {},
+        };
+    }
+
+    worker_ = std::thread([this]() {
+        workerLoop();
+    });
+}
+
+LevelPrefetcher::~LevelPrefetcher()
+{
+    {
+        std::lock_guard guard(lock_);
+        shutdown_ = true;
+    }
+    wakeCV_.notify_one();
+    worker_.join();
+
+    for (uint32_t i = 0; i < numWorlds_; i++) {
+        slots_[i].~LevelPrefetchSlot();
+    }
+    free(slots_);
+}
+
+void LevelPrefetcher::wake()
+{
+    {
+        std::lock_guard guard(lock_);
+        wakePending_ = true;
+    }
+    wakeCV_.notify_one();
+}
+
+void LevelPrefetcher::workerLoop()
+{
+    while (true) {
+        {
+            std::unique_lock guard(lock_);
+            wakeCV_.wait(guard, [this]() {
+                return wakePending_ || shutdown_;
+            });
+
+            if (shutdown_) {
+                return;
+            }
+
+            wakePending_ = false;
+        }
+
+        for (uint32_t i = 0; i < numWorlds_; i++) {
+            LevelPrefetchSlot &slot = slots_[i];
+
+            uint32_t episode = slot.requestedEpisode.load_acquire();
+            if (slot.readyEpisode.load_relaxed() == episode) {
+                continue;
+            }
+
+            // Same key initWorld derives for this world & episode
+            RNG rng(rand::split_i(initRandKey_, episode, i));
+            sampleLevelLayout(rng, slot.layout);
+
+            slot.readyEpisode.store_release(episode);
+        }
+    }
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace madEscape {
+
+// Background thread that samples the layout of each world's next episode
+// while the current one is still running, so resets on the CPU backend only
+// have to instantiate a ready layout. Layouts are sampled from the same
+// random keys the worlds use, so levels don't depend on whether the prefetch
+// thread kept up: a world whose layout isn't ready just generates it inline.
+class LevelPrefetcher {
+public:
+    LevelPrefetcher(uint32_t num_worlds, RandKey init_rand_key);
+    ~LevelPrefetcher();
+
+    LevelPrefetcher(const LevelPrefetcher &) = delete;
+    LevelPrefetcher & operator=(const LevelPrefetcher &) = delete;
+
+    // Passed to the worlds through Sim::Config::levelPrefetchSlots
+    inline LevelPrefetchSlot * slots() { return slots_; }
+
+    // Called after each step so the thread picks up the worlds that
+    // consumed their prepared layout
+    void wake();
+
+private:
+    void workerLoop();
+
+    uint32_t numWorlds_;
+    RandKey initRandKey_;
+    LevelPrefetchSlot *slots_;
+
+    std::mutex lock_;
+    std::condition_variable wakeCV_;
+    bool wakePending_;
+    bool shutdown_;
+    std::thread worker_;
+};
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "fast_math.hpp"
+
+#include <madrona/math.hpp>
+
+namespace madEscape {
+
+// Agent space lidar ray directions, evaluated at compile time. Sample i
+// points 2pi * i / num_samples + pi / 2 off the agent's right axis, so sample
+// 0 looks straight ahead. x is along the agent's right axis and y along its
+// forward axis, matching madrona::math::right / fwd.
+template <madrona::CountT num_samples>
+struct LidarDirections {
+    float x[num_samples];
+    float y[num_samples];
+
+    constexpr LidarDirections()
+        : x(),
+          y()
+    {
+        for (madrona::CountT i = 0; i < num_samples; i++) {
+            float theta = 2.f * fastmath::pi * (
+                float(i) / float(num_samples)) + fastmath::halfPi;
+            x[i] = fastmath::cos(theta);
+            y[i] = fastmath::sin(theta);
+        }
+    }
+};
+
+template <madrona::CountT num_samples>
+inline constexpr LidarDirections<num_samples> lidarDirections {};
+
+// Agents can only rotate around Z (their inverse inertia is zeroed on X and
+// Y in src/mgr.cpp), so their rotation reduces to one cos / sin pair that
+// can be read straight off the quaternion.
+struct YawRotation {
+    float cosYaw;
+    float sinYaw;
+
+    // q must be a pure yaw rotation (q.x == q.y == 0); any X / Y component
+    // is ignored. q doesn't need to be exactly unit length: the pair is
+    // divided by w^2 + z^2, so norm drift from integration doesn't scale
+    // the ray directions.
+    static inline YawRotation fromQuat(madrona::math::Quat q)
+    {
+        float inv_norm2 = 1.f / (q.w * q.w + q.z * q.z);
+
+        return YawRotation {
+            .cosYaw = (q.w * q.w - q.z * q.z) * inv_norm2,
+            .sinYaw = 2.f * q.w * q.z * inv_norm2,
+        };
+    }
+
+    // Rotates the agent space direction (x right, y forward) to world space
+    inline madrona::math::Vector3 rotate(float x, float y) const
+    {
+        return madrona::math::Vector3 {
+            cosYaw * x - sinYaw * y,
+            sinYaw * x + cosYaw * y,
+            0.f,
+        };
+    }
+
+    // World space direction of lidar sample idx
+    template <madrona::CountT num_samples>
+    inline madrona::math::Vector3 lidarDir(madrona::CountT idx) const
+    {
+        const LidarDirections<num_samples> &dirs =
+            lidarDirections<num_samples>;
+
+        return rotate(dirs.x[idx], dirs.y[idx]);
+    }
+};
+
+}
@@ -1,5 +1,8 @@
 #include "mgr.hpp"
 #include "sim.hpp"
+#include "level_bank.hpp"
+#include "level_prefetch.hpp"
+#include "worker_placement.hpp"
 
 #include <madrona/utils.hpp>
 #include <madrona/importer.hpp>
@@ -8,8 +11,11 @@
 #include <madrona/mw_cpu.hpp>
 #include <madrona/render/api.hpp>
 
+#include <algorithm>
 #include <array>
 #include <charconv>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
@@ -52,6 +58,16 @@ static inline Optional<RenderGPUState> initRenderGPUState(
     };
 }
 
+static inline Optional<LevelBank> loadLevelBank(
+    const Manager::Config &mgr_cfg)
+{
+    if (mgr_cfg.levelBankPath == nullptr) {
+        return Optional<LevelBank>::none();
+    }
+
+    return LevelBank::load(mgr_cfg.levelBankPath);
+}
+
 static inline Optional<render::RenderManager> initRenderManager(
     const Manager::Config &mgr_cfg,
     const Optional<RenderGPUState> &render_gpu_state)
@@ -108,7 +124,24 @@ struct Manager::Impl {
 
     inline virtual ~Impl() {}
 
-    virtual void run() = 0;
+    virtual void run(TaskGraphID graph) = 0;
+
+    // Sets the reset flag of every world in world_idxs, which the caller
+    // has checked are in range
+    virtual void setResetFlags(const int32_t *world_idxs,
+                               int64_t num_worlds) = 0;
+
+    // Feeds the ECS state to the renderer after running a task graph
+    inline void updateRender()
+    {
+        if (renderMgr.has_value()) {
+            renderMgr->readECS();
+        }
+
+        if (cfg.enableBatchRenderer) {
+            renderMgr->batchRender();
+        }
+    }
 
     virtual Tensor exportTensor(ExportID slot,
         TensorElementType type,
@@ -121,6 +154,11 @@ struct Manager::CPUImpl final : Manager::Impl {
     using TaskGraphT =
         TaskGraphExecutor<Engine, Sim, Sim::Config, Sim::WorldInit>;
 
+    // Worlds read levels straight out of the mapped file, so it must
+    // outlive cpuExec
+    Optional<LevelBank> levelBank;
+    // Worlds hold pointers into its slots, so it must outlive cpuExec too
+    std::unique_ptr<LevelPrefetcher> levelPrefetcher;
     TaskGraphT cpuExec;
 
     inline CPUImpl(const Manager::Config &mgr_cfg,
@@ -129,18 +167,35 @@ struct Manager::CPUImpl final : Manager::Impl {
                    Action *action_buffer,
                    Optional<RenderGPUState> &&render_gpu_state,
                    Optional<render::RenderManager> &&render_mgr,
+                   Optional<LevelBank> &&level_bank,
+                   std::unique_ptr<LevelPrefetcher> &&level_prefetcher,
                    TaskGraphT &&cpu_exec)
         : Impl(mgr_cfg, std::move(phys_loader),
                reset_buffer, action_buffer,
                std::move(render_gpu_state), std::move(render_mgr)),
+          levelBank(std::move(level_bank)),
+          levelPrefetcher(std::move(level_prefetcher)),
           cpuExec(std::move(cpu_exec))
     {}
 
     inline virtual ~CPUImpl() final {}
 
-    inline virtual void run()
+    inline virtual void run(TaskGraphID graph)
+    {
+        cpuExec.runTaskGraph(graph);
+
+        // Worlds that were reset now want the layout of their next episode
+        if (levelPrefetcher) {
+            levelPrefetcher->wake();
+        }
+    }
+
+    inline virtual void setResetFlags(const int32_t *world_idxs,
+                                      int64_t num_worlds)
     {
-        cpuExec.run();
+        for (int64_t i = 0; i < num_worlds; i++) {
+            worldResetBuffer[world_idxs[i]].reset = 1;
+        }
     }
 
     virtual inline Tensor exportTensor(ExportID slot,
@@ -156,6 +211,13 @@ struct Manager::CPUImpl final : Manager::Impl {
 struct Manager::CUDAImpl final : Manager::Impl {
     MWCudaExecutor gpuExec;
     MWCudaLaunchGraph stepGraph;
+    MWCudaLaunchGraph resetGraph;
+    MWCudaLaunchGraph observeGraph;
+    MWCudaLaunchGraph repeatStepGraph;
+    // Device copy of the level bank, nullptr if none was loaded
+    void *levelBankGPU;
+    // Host copy of the reset flags for setResetFlags
+    HeapArray<WorldReset> resetStaging;
 
     inline CUDAImpl(const Manager::Config &mgr_cfg,
                    PhysicsLoader &&phys_loader,
@@ -163,19 +225,74 @@ struct Manager::CUDAImpl final : Manager::Impl {
                    Action *action_buffer,
                    Optional<RenderGPUState> &&render_gpu_state,
                    Optional<render::RenderManager> &&render_mgr,
+                   void *level_bank_gpu,
                    MWCudaExecutor &&gpu_exec)
         : Impl(mgr_cfg, std::move(phys_loader),
                reset_buffer, action_buffer,
                std::move(render_gpu_state), std::move(render_mgr)),
           gpuExec(std::move(gpu_exec)),
-          stepGraph(gpuExec.buildLaunchGraphAllTaskGraphs())
+          stepGraph(gpuExec.buildLaunchGraph(TaskGraphID::Step)),
+          resetGraph(gpuExec.buildLaunchGraph(TaskGraphID::Reset)),
+          observeGraph(gpuExec.buildLaunchGraph(TaskGraphID::Observe)),
+          repeatStepGraph(gpuExec.buildLaunchGraph(TaskGraphID::RepeatStep)),
+          levelBankGPU(level_bank_gpu),
+          resetStaging(mgr_cfg.numWorlds)
     {}
 
-    inline virtual ~CUDAImpl() final {}
+    inline virtual ~CUDAImpl() final
+    {
+        if (levelBankGPU != nullptr) {
+            cu::deallocGPU(levelBankGPU);
+        }
+    }
+
+    inline virtual void run(TaskGraphID graph)
+    {
+        switch (graph) {
+        case TaskGraphID::Step: {
+            gpuExec.run(stepGraph);
+        } break;
+        case TaskGraphID::Reset: {
+            gpuExec.run(resetGraph);
+        } break;
+        case TaskGraphID::Observe: {
+            gpuExec.run(observeGraph);
+        } break;
+        case TaskGraphID::RepeatStep: {
+            gpuExec.run(repeatStepGraph);
+        } break;
+        default: MADRONA_UNREACHABLE();
+        }
+    }
 
-    inline virtual void run()
+    // Round trips the flags of the worlds from the lowest to the highest
+    // index in world_idxs, so the flags of the worlds in between are kept:
+    // two copies of at most 4 bytes per world, however many worlds are
+    // flagged. A copy per flagged world would cost one API call each, and a
+    // scatter kernel would need its own NVRTC compile for a call that
+    // happens at most once per step.
+    inline virtual void setResetFlags(const int32_t *world_idxs,
+                                      int64_t num_worlds)
     {
-        gpuExec.run(stepGraph);
+        int32_t min_world = world_idxs[0];
+        int32_t max_world = world_idxs[0];
+        for (int64_t i = 1; i < num_worlds; i++) {
+            min_world = std::min(min_world, world_idxs[i]);
+            max_world = std::max(max_world, world_idxs[i]);
+        }
+
+        CountT num_flags = max_world - min_world + 1;
+        WorldReset *range_ptr = worldResetBuffer + min_world;
+
+        cudaMemcpy(resetStaging.data(), range_ptr,
+                   sizeof(WorldReset) * num_flags, cudaMemcpyDeviceToHost);
+
+        for (int64_t i = 0; i < num_worlds; i++) {
+            resetStaging[world_idxs[i] - min_world].reset = 1;
+        }
+
+        cudaMemcpy(range_ptr, resetStaging.data(),
+                   sizeof(WorldReset) * num_flags, cudaMemcpyHostToDevice);
     }
 
     virtual inline Tensor exportTensor(ExportID slot,
@@ -427,8 +544,26 @@ Manager::Impl * Manager::Impl::init(
 {
     Sim::Config sim_cfg;
     sim_cfg.autoReset = mgr_cfg.autoReset;
+    sim_cfg.useEntityPool = mgr_cfg.useEntityPool;
+    sim_cfg.useRaycastScene =
+        mgr_cfg.useRaycastScene || mgr_cfg.planarLidar;
+    sim_cfg.simdObservations = mgr_cfg.simdObservations;
+    sim_cfg.planarLidar = mgr_cfg.planarLidar;
+    sim_cfg.bvhButtonQuery = mgr_cfg.bvhButtonQuery;
+    sim_cfg.unfusedRewards = mgr_cfg.unfusedRewards;
+    sim_cfg.compactObservations = mgr_cfg.compactObservations;
+    sim_cfg.fusedObservations =
+        mgr_cfg.fusedObservations || mgr_cfg.frameStacking;
+    sim_cfg.frameStacking = mgr_cfg.frameStacking;
+    sim_cfg.taskTimings = mgr_cfg.taskTimings;
     sim_cfg.initRandKey = rand::initKey(mgr_cfg.randSeed);
 
+    Optional<LevelBank> level_bank = loadLevelBank(mgr_cfg);
+    sim_cfg.levelBank = nullptr;
+    sim_cfg.numBankLevels =
+        level_bank.has_value() ? level_bank->numLevels() : 0;
+    sim_cfg.levelPrefetchSlots = nullptr;
+
     switch (mgr_cfg.execMode) {
     case ExecMode::CUDA: {
 #ifdef MADRONA_CUDA_SUPPORT
@@ -453,6 +588,15 @@ Manager::Impl * Manager::Impl::init(
             sim_cfg.renderBridge = nullptr;
         }
 
+        // The host mapping is released once this copy is made
+        void *level_bank_gpu = nullptr;
+        if (level_bank.has_value()) {
+            level_bank_gpu = cu::allocGPU(level_bank->numLevelBytes());
+            cudaMemcpy(level_bank_gpu, level_bank->levels(),
+                       level_bank->numLevelBytes(), cudaMemcpyHostToDevice);
+            sim_cfg.levelBank = (const LevelLayout *)level_bank_gpu;
+        }
+
         HeapArray<Sim::WorldInit> world_inits(mgr_cfg.numWorlds);
 
         MWCudaExecutor gpu_exec({
@@ -463,11 +607,18 @@ Manager::Impl * Manager::Impl::init(
             .numWorldDataBytes = sizeof(Sim),
             .worldDataAlignment = alignof(Sim),
             .numWorlds = mgr_cfg.numWorlds,
-            .numTaskGraphs = 1,
+            .numTaskGraphs = (uint32_t)TaskGraphID::NumTaskGraphs,
             .numExportedBuffers = (uint32_t)ExportID::NumExports, 
         }, {
             { GPU_HIDESEEK_SRC_LIST },
-            { GPU_HIDESEEK_COMPILE_FLAGS },
+            // The simulator sources are compiled at runtime by NVRTC, which
+            // doesn't see this target's compile definitions
+            {
+                GPU_HIDESEEK_COMPILE_FLAGS,
+#if MADESCAPE_FAST_TRIG
+                "-DMADESCAPE_FAST_TRIG=1",
+#endif
+            },
             CompileConfig::OptMode::LTO,
         }, cu_ctx);
 
@@ -484,6 +635,7 @@ Manager::Impl * Manager::Impl::init(
             agent_actions_buffer,
             std::move(render_gpu_state),
             std::move(render_mgr),
+            level_bank_gpu,
             std::move(gpu_exec),
         };
 #else
@@ -510,18 +662,46 @@ Manager::Impl * Manager::Impl::init(
             sim_cfg.renderBridge = nullptr;
         }
 
+        if (level_bank.has_value()) {
+            sim_cfg.levelBank = level_bank->levels();
+        }
+
+        // Levels from a bank are already precomputed
+        std::unique_ptr<LevelPrefetcher> level_prefetcher;
+        if (mgr_cfg.prefetchLevels && !level_bank.has_value()) {
+            level_prefetcher = std::make_unique<LevelPrefetcher>(
+                mgr_cfg.numWorlds, sim_cfg.initRandKey);
+            sim_cfg.levelPrefetchSlots = level_prefetcher->slots();
+        }
+
         HeapArray<Sim::WorldInit> world_inits(mgr_cfg.numWorlds);
 
+        // The executor starts its worker threads and initializes the worlds
+        // in its constructor, under the placement set up here
+        WorkerPlacement worker_placement(mgr_cfg.numaNode);
+
+        // Pinning needs the exact number of workers to recognize them
+        uint32_t num_workers = mgr_cfg.numWorkers;
+        if (num_workers == 0 &&
+                (mgr_cfg.numaNode >= 0 || mgr_cfg.pinWorkers)) {
+            num_workers = worker_placement.numCPUs();
+        }
+
         CPUImpl::TaskGraphT cpu_exec {
             ThreadPoolExecutor::Config {
                 .numWorlds = mgr_cfg.numWorlds,
                 .numExportedBuffers = (uint32_t)ExportID::NumExports,
+                .numWorkers = num_workers,
             },
             sim_cfg,
             world_inits.data(),
             (uint32_t)TaskGraphID::NumTaskGraphs,
         };
 
+        if (mgr_cfg.pinWorkers) {
+            worker_placement.pinNewThreads(num_workers);
+        }
+
         WorldReset *world_reset_buffer = 
             (WorldReset *)cpu_exec.getExported((uint32_t)ExportID::Reset);
 
@@ -535,6 +715,8 @@ Manager::Impl * Manager::Impl::init(
             agent_actions_buffer,
             std::move(render_gpu_state),
             std::move(render_mgr),
+            std::move(level_bank),
+            std::move(level_prefetcher),
             std::move(cpu_exec),
         };
 
@@ -547,35 +729,46 @@ Manager::Impl * Manager::Impl::init(
 Manager::Manager(const Config &cfg)
     : impl_(Impl::init(cfg))
 {
-    // Currently, there is no way to populate the initial set of observations
-    // without stepping the simulations in order to execute the taskgraph.
-    // Therefore, after setup, we step all the simulations with a forced reset
-    // that ensures the first real step will have valid observations at the
+    // Run the Reset task graph with no world flagged: every world already
+    // generated its first level in the Sim constructor, so this only
+    // populates the initial set of observations without stepping physics.
+    // This ensures the first real step will have valid observations at the
     // start of a fresh episode in order to compute actions.
-    //
-    // This will be improved in the future with support for multiple task
-    // graphs, allowing a small task graph to be executed after initialization.
-    
-    for (int32_t i = 0; i < (int32_t)cfg.numWorlds; i++) {
-        triggerReset(i);
-    }
-
-    step();
+    reset();
 }
 
 Manager::~Manager() {}
 
-void Manager::step()
+void Manager::step(int32_t num_steps)
 {
-    impl_->run();
+    if (num_steps < 1) {
+        FATAL("step: num_steps must be at least 1, got %d", num_steps);
+    }
 
-    if (impl_->renderMgr.has_value()) {
-        impl_->renderMgr->readECS();
+    if (num_steps > 1 && impl_->cfg.unfusedRewards) {
+        FATAL("step: num_steps > 1 is not supported with unfusedRewards");
     }
 
-    if (impl_->cfg.enableBatchRenderer) {
-        impl_->renderMgr->batchRender();
+    // Observations are only collected by the last step
+    for (int32_t i = 1; i < num_steps; i++) {
+        impl_->run(TaskGraphID::RepeatStep);
     }
+
+    impl_->run(TaskGraphID::Step);
+
+    impl_->updateRender();
+}
+
+void Manager::reset()
+{
+    impl_->run(TaskGraphID::Reset);
+    impl_->updateRender();
+}
+
+void Manager::refreshObservations()
+{
+    impl_->run(TaskGraphID::Observe);
+    impl_->updateRender();
 }
 
 Tensor Manager::resetTensor() const
@@ -686,6 +879,179 @@ Tensor Manager::stepsRemainingTensor() const
                                });
 }
 
+Tensor Manager::levelSelectTensor() const
+{
+    return impl_->exportTensor(ExportID::LevelSelect,
+                               TensorElementType::Int32,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   2,
+                               });
+}
+
+Tensor Manager::buttonPressesTensor() const
+{
+    return impl_->exportTensor(ExportID::ButtonPresses,
+                               TensorElementType::Int32,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   2,
+                               });
+}
+
+Tensor Manager::selfObservationF16Tensor() const
+{
+    return impl_->exportTensor(ExportID::SelfObservationF16,
+                               TensorElementType::Float16,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   8,
+                               });
+}
+
+Tensor Manager::partnerObservationsF16Tensor() const
+{
+    return impl_->exportTensor(ExportID::PartnerObservationsF16,
+                               TensorElementType::Float16,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   consts::numAgents - 1,
+                                   3,
+                               });
+}
+
+Tensor Manager::roomEntityObservationsF16Tensor() const
+{
+    return impl_->exportTensor(ExportID::RoomEntityObservationsF16,
+                               TensorElementType::Float16,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   consts::maxEntitiesPerRoom,
+                                   3,
+                               });
+}
+
+Tensor Manager::doorObservationF16Tensor() const
+{
+    return impl_->exportTensor(ExportID::DoorObservationF16,
+                               TensorElementType::Float16,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   3,
+                               });
+}
+
+Tensor Manager::lidarU8Tensor() const
+{
+    return impl_->exportTensor(ExportID::LidarU8, TensorElementType::UInt8,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   consts::numLidarSamples,
+                                   2,
+                               });
+}
+
+Tensor Manager::fusedObservationTensor() const
+{
+    return impl_->exportTensor(ExportID::FusedObservation,
+                               TensorElementType::Float32,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   FusedObservation::numFeatures,
+                               });
+}
+
+Tensor Manager::observationFramesTensor() const
+{
+    return impl_->exportTensor(ExportID::ObservationFrames,
+                               TensorElementType::Float32,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   consts::numStackedFrames,
+                                   FusedObservation::numFeatures,
+                               });
+}
+
+Tensor Manager::observationFrameHeadTensor() const
+{
+    return impl_->exportTensor(ExportID::ObservationFrameHead,
+                               TensorElementType::Int32,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   1,
+                               });
+}
+
+// The timings live in world 0's TaskTimings singleton, at the start of the
+// exported buffer. lastTimestamp is internal and not part of the tensor.
+Tensor Manager::taskTimingsTensor() const
+{
+    return impl_->exportTensor(ExportID::TaskTimings,
+                               TensorElementType::Int64,
+                               {
+                                   (int64_t)TaskPhase::NumPhases + 1,
+                               });
+}
+
+Span<const char * const> Manager::taskPhaseNames()
+{
+    static constexpr const char *names[] = {
+        "movement",
+        "broadphase",
+        "grab",
+        "physics",
+        "buttons",
+        "rewards",
+        "reset",
+        "observations",
+        "lidar",
+    };
+    static_assert(std::size(names) == (size_t)TaskPhase::NumPhases);
+
+    return Span<const char * const>(names, std::size(names));
+}
+
+void Manager::printTaskTimings() const
+{
+    TaskTimings timings;
+    const void *src = taskTimingsTensor().devicePtr();
+
+    if (impl_->cfg.execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+        cudaMemcpy(&timings, src, sizeof(TaskTimings),
+                   cudaMemcpyDeviceToHost);
+#endif
+    } else {
+        memcpy(&timings, src, sizeof(TaskTimings));
+    }
+
+    if (timings.numSteps == 0) {
+        printf("No timed steps, set Manager::Config::taskTimings\n");
+        return;
+    }
+
+    int64_t total_ns = 0;
+    for (CountT i = 0; i < (CountT)TaskPhase::NumPhases; i++) {
+        total_ns += timings.phaseNs[i];
+    }
+
+    Span<const char * const> names = taskPhaseNames();
+    for (CountT i = 0; i < (CountT)TaskPhase::NumPhases; i++) {
+        printf("%-14s %10.3f us/call %6.2f%%\n", names[i],
+               1e-3 * (double)timings.phaseNs[i] / (double)timings.numSteps,
+               total_ns > 0 ?
+                   100.0 * (double)timings.phaseNs[i] / (double)total_ns : 0.0);
+    }
+}
+
 Tensor Manager::rgbTensor() const
 {
     const uint8_t *rgb_ptr = impl_->renderMgr->batchRendererRGBOut();
@@ -757,6 +1123,52 @@ void Manager::setAction(int32_t world_idx,
     }
 }
 
+void Manager::setActions(const Action *actions, int64_t num_agents)
+{
+    int64_t max_agents = (int64_t)impl_->cfg.numWorlds * consts::numAgents;
+    if (num_agents < 0 || num_agents > max_agents) {
+        FATAL("setActions: %lld actions for %lld agents",
+              (long long)num_agents, (long long)max_agents);
+    }
+
+    if (impl_->cfg.execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+        cudaMemcpy(impl_->agentActionsBuffer, actions,
+                   sizeof(Action) * num_agents, cudaMemcpyHostToDevice);
+#endif
+    } else {
+        memcpy(impl_->agentActionsBuffer, actions,
+               sizeof(Action) * num_agents);
+    }
+}
+
+void Manager::triggerResets(const int32_t *world_idxs, int64_t num_worlds)
+{
+    if (num_worlds < 0) {
+        FATAL("triggerResets: negative world count %lld",
+              (long long)num_worlds);
+    }
+
+    for (int64_t i = 0; i < num_worlds; i++) {
+        if (world_idxs[i] < 0 ||
+                world_idxs[i] >= (int64_t)impl_->cfg.numWorlds) {
+            FATAL("triggerResets: world %d out of range [0, %u)",
+                  world_idxs[i], impl_->cfg.numWorlds);
+        }
+    }
+
+    if (num_worlds == 0) {
+        return;
+    }
+
+    impl_->setResetFlags(world_idxs, num_worlds);
+}
+
+uint32_t Manager::numWorlds() const
+{
+    return impl_->cfg.numWorlds;
+}
+
 render::RenderManager & Manager::getRenderManager()
 {
     return *impl_->renderMgr;
@@ -7,6 +7,8 @@
 
 namespace madEscape {
 
+struct Action;
+
 // The Manager class encapsulates the linkage between the outside training
 // code and the internal simulation state (src/sim.hpp / src/sim.cpp)
 //
@@ -26,12 +28,93 @@ public:
         uint32_t batchRenderViewHeight = 64;
         madrona::render::APIBackend *extRenderAPI = nullptr;
         madrona::render::GPUDevice *extRenderDev = nullptr;
+        // Re-initialize a per-world pool of level entities on reset instead
+        // of destroying and recreating them
+        bool useEntityPool = true;
+        // Optional level bank file written by level_bank_gen. When set,
+        // every episode instantiates a level from the bank rather than
+        // randomly generating one (see levelSelectTensor).
+        const char *levelBankPath = nullptr;
+        // Trace lidar and grab rays against a per-world static / dynamic
+        // box hierarchy instead of the physics BVH (src/raycast.hpp)
+        bool useRaycastScene = false;
+        // CPU backend only: sample the layout of each world's next episode
+        // on a background thread so resets only instantiate it. Ignored
+        // when a level bank is loaded.
+        bool prefetchLevels = false;
+        // CPU backend only: number of worker threads stepping the worlds,
+        // 0 for one per hardware thread (of numaNode if set)
+        uint32_t numWorkers = 0;
+        // CPU backend only: run the worker threads on the CPUs of this NUMA
+        // node and allocate the worlds from its memory, -1 to leave it to
+        // the OS. Use one manager per node to cover several sockets.
+        int32_t numaNode = -1;
+        // CPU backend only: pin each worker thread to a single CPU. Skipped
+        // with a warning if other code started threads while the workers
+        // were being created, since those can't be told apart.
+        bool pinWorkers = false;
+        // CPU backend only: batch each agent's polar observations into one
+        // SIMD pass. Matches the scalar path to within 1e-6.
+        bool simdObservations = true;
+        // CPU backend only: trace lidar as horizontal rays, walking the
+        // raycast scene's trees with 2D node and box tests where the rays'
+        // height allows it. Gives the same samples. Implies useRaycastScene.
+        bool planarLidar = false;
+        // Check buttons with one physics BVH query per button, the query
+        // the per-world button grid replaced. Same presses, slower; kept
+        // as the reference the grid is tested against.
+        bool bvhButtonQuery = false;
+        // Also export fp16 observations and uint8 lidar, see the *F16 /
+        // lidarU8 tensors below. The compact components are part of the
+        // Agent archetype either way (archetypes are fixed at registration),
+        // so leaving this off saves their update work but not their 124
+        // bytes per agent.
+        bool compactObservations = false;
+        // Also export all observations of each agent as one contiguous
+        // float buffer, see fusedObservationTensor
+        bool fusedObservations = false;
+        // Also keep the last consts::numStackedFrames fused observations of
+        // each agent, see observationFramesTensor. Implies
+        // fusedObservations. The number of frames is a compile time
+        // constant (ObservationFrames is a fixed size component, 1.5KB per
+        // agent, allocated even when this is off); change
+        // consts::numStackedFrames and rebuild for a different depth.
+        bool frameStacking = false;
+        // Run the reward, partner bonus and episode step tracking systems as
+        // three nodes over all agents, the order they ran in before being
+        // fused into one node per world. Same rewards and dones; kept as the
+        // reference the fused node is tested against. Only supports
+        // step(1), since the three nodes don't sum rewards over the steps
+        // of a call.
+        bool unfusedRewards = false;
+        // Time each phase of the Step graph (movement, broadphase, grab,
+        // physics, buttons, rewards, reset, observations, lidar), see
+        // taskTimingsTensor
+        bool taskTimings = false;
     };
 
     Manager(const Config &cfg);
     ~Manager();
 
-    void step();
+    // Advances the simulation by num_steps steps, holding the current
+    // actions (a grab is only triggered once). The reward tensor receives
+    // the sum of the rewards of all steps, and done is set if the episode
+    // ended during any of them; for such agents the steps after the end
+    // add no more reward. With autoReset, a world whose episode ends
+    // mid-call is reset and keeps stepping like num_steps step() calls
+    // would. Observations are only collected after the last step.
+    // num_steps < 1 is a fatal error.
+    void step(int32_t num_steps = 1);
+
+    // Regenerates only the worlds whose reset flag is set (triggerReset /
+    // resetTensor) and recomputes observations for all worlds, without
+    // running physics, rewards or episode tracking. Reward and done are
+    // cleared for the worlds that were reset.
+    void reset();
+
+    // Recomputes observations from the current simulation state without
+    // stepping, e.g. after external code modified the worlds.
+    void refreshObservations();
 
     // These functions export Tensor objects that link the ECS
     // simulation state to the python bindings / PyTorch tensors (src/bindings.cpp)
@@ -45,6 +128,50 @@ public:
     madrona::py::Tensor doorObservationTensor() const;
     madrona::py::Tensor lidarTensor() const;
     madrona::py::Tensor stepsRemainingTensor() const;
+    // [numWorlds, 2] (requested, current) level bank indices. Write a level
+    // index to requested before resetting a world to replay that level.
+    // Indices outside the bank are ignored and a random level is played.
+    madrona::py::Tensor levelSelectTensor() const;
+    // [numWorlds, 2] int32 (pressed, doorsEvaluated) ButtonPresses of each
+    // world. Bit buttonBit(room, slot) of pressed is set while that button
+    // is pressed (see src/types.hpp).
+    madrona::py::Tensor buttonPressesTensor() const;
+
+    // Compact variants of the observation tensors, with the same shapes.
+    // Only written when Config::compactObservations is set. The *F16
+    // tensors are float16; lidarU8 is [N, A, numLidarSamples, 2] uint8
+    // (depth * 255, raw EntityType).
+    madrona::py::Tensor selfObservationF16Tensor() const;
+    madrona::py::Tensor partnerObservationsF16Tensor() const;
+    madrona::py::Tensor roomEntityObservationsF16Tensor() const;
+    madrona::py::Tensor doorObservationF16Tensor() const;
+    madrona::py::Tensor lidarU8Tensor() const;
+
+    // [N, A, FusedObservation::numFeatures] float tensor with every
+    // observation of each agent, laid out as documented on FusedObservation
+    // (src/types.hpp). Only written when Config::fusedObservations is set.
+    madrona::py::Tensor fusedObservationTensor() const;
+
+    // [N, A, numStackedFrames, FusedObservation::numFeatures] ring buffer of
+    // past fused observations and the [N, A, 1] int32 slot of the newest
+    // frame (see ObservationFrames in src/types.hpp). Each step writes one
+    // frame, a reset clears the agent's frames. Only written when
+    // Config::frameStacking is set.
+    madrona::py::Tensor observationFramesTensor() const;
+    madrona::py::Tensor observationFrameHeadTensor() const;
+
+    // int64 tensor with the nanoseconds spent in each phase named by
+    // taskPhaseNames(), summed over all steps since initialization,
+    // followed by the number of step() calls. With step(num_steps > 1) the
+    // simulation phases sum all num_steps steps of a call while
+    // observations and lidar run once, so averages are per call. Write
+    // zeros to restart the accounting. Only written when
+    // Config::taskTimings is set.
+    madrona::py::Tensor taskTimingsTensor() const;
+    static madrona::Span<const char * const> taskPhaseNames();
+    // Prints the average time per step() call of every phase to stdout
+    void printTaskTimings() const;
+
     madrona::py::Tensor rgbTensor() const;
     madrona::py::Tensor depthTensor() const;
 
@@ -58,6 +185,18 @@ public:
                    int32_t rotate,
                    int32_t grab);
 
+    // Bulk versions of the above for scripted agents. setActions writes the
+    // actions of the first num_agents agents in the [world][agent] order
+    // of actionTensor, with one copy on the CUDA backend. triggerResets
+    // flags every world in world_idxs for reset, with one copy each way
+    // over the flags from the lowest to the highest index on the CUDA
+    // backend. Counts over numWorlds() * consts::numAgents agents and
+    // world indices outside [0, numWorlds()) are fatal errors.
+    void setActions(const Action *actions, int64_t num_agents);
+    void triggerResets(const int32_t *world_idxs, int64_t num_worlds);
+
+    uint32_t numWorlds() const;
+
     madrona::render::RenderManager & getRenderManager();
 
 private:
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "simd.hpp"
+#include "consts.hpp"
+
+#include <madrona/math.hpp>
+
+namespace madEscape {
+
+// Batched version of xyToPolar(to_view.rotateVec(d)) (src/sim.cpp) for
+// simd::floatLanes world space offsets stored as SoA (dx, dy, dz). Outputs
+// are already normalized like distObs / angleObs.
+//
+// to_view is applied as a rotation matrix rather than a quaternion, and with
+// MADESCAPE_FAST_TRIG atan2 is a polynomial approximation (libm's otherwise,
+// as in the scalar path), so results differ slightly from the scalar path:
+// both r and theta are within 1e-6 of it in observation units, except theta
+// for offsets shorter than ~1cm, where the angle itself is ill-conditioned.
+inline void polarObservationsSIMD(const float *dx,
+                                  const float *dy,
+                                  const float *dz,
+                                  madrona::math::Quat to_view,
+                                  float *out_r,
+                                  float *out_theta)
+{
+    using namespace simd;
+
+    const madrona::math::Quat &q = to_view;
+
+    // First two rows of the rotation matrix, the rotated z is unused
+    Float8 m00 = set1(1.f - 2.f * (q.y * q.y + q.z * q.z));
+    Float8 m01 = set1(2.f * (q.x * q.y - q.w * q.z));
+    Float8 m02 = set1(2.f * (q.x * q.z + q.w * q.y));
+    Float8 m10 = set1(2.f * (q.x * q.y + q.w * q.z));
+    Float8 m11 = set1(1.f - 2.f * (q.x * q.x + q.z * q.z));
+    Float8 m12 = set1(2.f * (q.y * q.z - q.w * q.x));
+
+    Float8 x = load(dx);
+    Float8 y = load(dy);
+    Float8 z = load(dz);
+
+    Float8 view_x = m00 * x + m01 * y + m02 * z;
+    Float8 view_y = m10 * x + m11 * y + m12 * z;
+
+    Float8 r = sqrt(view_x * view_x + view_y * view_y);
+
+    // Note that this is angle off y-forward
+    Float8 theta = atan2(view_x, view_y);
+
+    store(out_r, r / set1(consts::worldLength));
+    store(out_theta, theta / set1(madrona::math::pi));
+}
+
+}
@@ -0,0 +1,174 @@
+#include "raycast.hpp"
+#include "sim.hpp"
+
+namespace madEscape {
+
+using namespace madrona;
+using namespace madrona::math;
+
+static inline AABB emptyAABB()
+{
+    return AABB {
+        .pMin = Vector3 { INFINITY, INFINITY, INFINITY },
+        .pMax = Vector3 { -INFINITY, -INFINITY, -INFINITY },
+    };
+}
+
+static inline AABB mergeAABB(const AABB &a, const AABB &b)
+{
+    return AABB {
+        .pMin = Vector3 {
+            fminf(a.pMin.x, b.pMin.x),
+            fminf(a.pMin.y, b.pMin.y),
+            fminf(a.pMin.z, b.pMin.z),
+        },
+        .pMax = Vector3 {
+            fmaxf(a.pMax.x, b.pMax.x),
+            fmaxf(a.pMax.y, b.pMax.y),
+            fmaxf(a.pMax.z, b.pMax.z),
+        },
+    };
+}
+
+// Recomputes all internal nodes of an implicit tree from its leaves
+template <CountT num_leaves>
+static inline void buildInternalNodes(AABB *nodes)
+{
+    for (CountT i = num_leaves - 2; i >= 0; i--) {
+        nodes[i] = mergeAABB(nodes[2 * i + 1], nodes[2 * i + 2]);
+    }
+}
+
+// Local space bounds of an entity's collision mesh
+static inline AABB objectAABB(Engine &ctx, Entity e)
+{
+    ObjectID obj_id = ctx.get<ObjectID>(e);
+    return ctx.data().rigidBodyObjMgr->rigidBodyAABBs[obj_id.idx];
+}
+
+static inline AABB worldAABB(Engine &ctx, Entity e)
+{
+    return objectAABB(ctx, e).applyTRS(
+        ctx.get<Position>(e), ctx.get<Rotation>(e), ctx.get<Scale>(e));
+}
+
+void buildRaycastScene(Engine &ctx)
+{
+    RaycastScene &scene = ctx.singleton<RaycastScene>();
+    const LevelState &level = ctx.singleton<LevelState>();
+
+    // Static leaves: borders and room walls, sorted along the length of the
+    // level so neighboring leaves are spatially close.
+    AABB static_aabbs[RaycastScene::maxStaticBoxes];
+    Entity static_entities[RaycastScene::maxStaticBoxes];
+    CountT num_static = 0;
+
+    auto addStatic = [&](Entity e) {
+        AABB aabb = worldAABB(ctx, e);
+        float y = aabb.pMin.y + aabb.pMax.y;
+
+        CountT insert_idx = num_static++;
+        while (insert_idx > 0) {
+            const AABB &prev = static_aabbs[insert_idx - 1];
+            if (prev.pMin.y + prev.pMax.y <= y) {
+                break;
+            }
+
+            static_aabbs[insert_idx] = prev;
+            static_entities[insert_idx] = static_entities[insert_idx - 1];
+            insert_idx--;
+        }
+
+        static_aabbs[insert_idx] = aabb;
+        static_entities[insert_idx] = e;
+    };
+
+    for (CountT i = 0; i < 3; i++) {
+        addStatic(ctx.data().borders[i]);
+    }
+
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        addStatic(level.rooms[i].walls[0]);
+        addStatic(level.rooms[i].walls[1]);
+    }
+
+    constexpr CountT first_static_leaf = RaycastScene::numStaticLeaves - 1;
+    for (CountT i = 0; i < RaycastScene::numStaticLeaves; i++) {
+        if (i < num_static) {
+            scene.staticNodes[first_static_leaf + i] = static_aabbs[i];
+            scene.staticEntities[i] = static_entities[i];
+        } else {
+            scene.staticNodes[first_static_leaf + i] = emptyAABB();
+            scene.staticEntities[i] = Entity::none();
+        }
+    }
+
+    buildInternalNodes<RaycastScene::numStaticLeaves>(scene.staticNodes);
+
+    // Dynamic leaves: agents, then each room's door followed by its cubes
+    CountT num_dynamic = 0;
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        scene.dynamicEntities[num_dynamic++] = ctx.data().agents[i];
+    }
+
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        const Room &room = level.rooms[i];
+        scene.dynamicEntities[num_dynamic++] = room.door;
+
+        for (CountT j = 0; j < consts::maxEntitiesPerRoom; j++) {
+            Entity e = room.entities[j];
+            if (e != Entity::none() &&
+                    ctx.get<EntityType>(e) == EntityType::Cube) {
+                scene.dynamicEntities[num_dynamic++] = e;
+            }
+        }
+    }
+
+    scene.numDynamic = num_dynamic;
+
+    constexpr CountT first_dynamic_leaf = RaycastScene::numDynamicLeaves - 1;
+    for (CountT i = num_dynamic; i < RaycastScene::numDynamicLeaves; i++) {
+        scene.dynamicNodes[first_dynamic_leaf + i] = emptyAABB();
+        scene.dynamicEntities[i] = Entity::none();
+    }
+
+    refitRaycastScene(ctx, scene);
+}
+
+void refitRaycastScene(Engine &ctx, RaycastScene &scene)
+{
+    constexpr CountT first_dynamic_leaf = RaycastScene::numDynamicLeaves - 1;
+
+    for (CountT i = 0; i < scene.numDynamic; i++) {
+        Entity e = scene.dynamicEntities[i];
+
+        AABB obj_aabb = objectAABB(ctx, e);
+        Vector3 pos = ctx.get<Position>(e);
+        Quat rot = ctx.get<Rotation>(e);
+        Diag3x3 scale = ctx.get<Scale>(e);
+
+        Vector3 local_center = 0.5f * (obj_aabb.pMin + obj_aabb.pMax);
+        Vector3 local_half = 0.5f * (obj_aabb.pMax - obj_aabb.pMin);
+
+        scene.dynamicBoxes[i] = {
+            .center = pos + rot.rotateVec(Vector3 {
+                local_center.x * scale.d0,
+                local_center.y * scale.d1,
+                local_center.z * scale.d2,
+            }),
+            .rot = rot,
+            .halfExtents = Vector3 {
+                local_half.x * fabsf(scale.d0),
+                local_half.y * fabsf(scale.d1),
+                local_half.z * fabsf(scale.d2),
+            },
+        };
+
+        scene.dynamicNodes[first_dynamic_leaf + i] =
+            obj_aabb.applyTRS(pos, rot, scale);
+    }
+
+    buildInternalNodes<RaycastScene::numDynamicLeaves>(scene.dynamicNodes);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace madEscape {
+
+class Engine;
+
+// RaycastScene is a per-world singleton used for lidar and grab raycasts in
+// place of the physics BVH when Sim::Config::useRaycastScene is set.
+//
+// It is split into two small BVHs:
+// - The static tree holds the border walls and the room walls. Its leaves
+//   are axis aligned, so they are stored exactly as AABBs. It is rebuilt
+//   once per episode in generateWorld.
+// - The dynamic tree holds agents, doors and cubes. Its leaf set is also
+//   fixed for the episode, but the leaves are refit every step from the
+//   entities' current transforms. The tree topology never changes.
+//
+// Both trees are implicit complete binary trees over a power of two number
+// of leaves: node i has children 2i+1 and 2i+2, and leaf j is stored in node
+// (numLeaves - 1 + j). Unused leaves hold an empty AABB.
+//
+// Every rigid body in this environment uses a box collision mesh, so leaves
+// are (oriented) boxes. The floor plane is left out: lidar and grab rays are
+// horizontal and start above it.
+struct RaycastScene {
+    static constexpr CountT maxStaticBoxes = 3 + 2 * consts::numRooms;
+    static constexpr CountT maxDynamicBoxes = consts::numAgents +
+        consts::numRooms * (1 + consts::maxCubesPerRoom);
+
+    static constexpr CountT numStaticLeaves = 16;
+    static constexpr CountT numDynamicLeaves = 32;
+    static_assert(maxStaticBoxes <= numStaticLeaves);
+    static_assert(maxDynamicBoxes <= numDynamicLeaves);
+
+    // Deep enough for either tree
+    static constexpr CountT maxTraversalDepth = 6;
+
+    // World space box of a dynamic leaf
+    struct Box {
+        madrona::math::Vector3 center;
+        madrona::math::Quat rot;
+        madrona::math::Vector3 halfExtents;
+    };
+
+    madrona::math::AABB staticNodes[2 * numStaticLeaves - 1];
+    Entity staticEntities[numStaticLeaves];
+
+    madrona::math::AABB dynamicNodes[2 * numDynamicLeaves - 1];
+    Box dynamicBoxes[numDynamicLeaves];
+    Entity dynamicEntities[numDynamicLeaves];
+    CountT numDynamic;
+};
+
+// Rebuilds the static tree and collects the dynamic leaf set for the level
+// generateWorld just created, then refits the dynamic tree.
+void buildRaycastScene(Engine &ctx);
+
+// Updates the dynamic leaves from their entities' Position / Rotation / Scale
+// and propagates the new bounds up the dynamic tree.
+void refitRaycastScene(Engine &ctx, RaycastScene &scene);
+
+// Returns the first entity hit by the ray within [0, t_max), or
+// Entity::none(). Boxes containing the ray origin are ignored, which keeps
+// agents from hitting their own body.
+inline Entity traceRaycastScene(const RaycastScene &scene,
+                                madrona::math::Vector3 ray_o,
+                                madrona::math::Vector3 ray_d,
+                                float *out_hit_t,
+                                float t_max);
+
+}
+
+#include "raycast.inl"
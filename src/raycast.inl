@@ -0,0 +1,129 @@
+namespace madEscape {
+
+namespace raycast {
+
+// Slab test against an AABB, returns the entry distance or INFINITY on a
+// miss. Empty (inverted) AABBs are always missed.
+inline float intersectAABB(const madrona::math::AABB &aabb,
+                           madrona::math::Vector3 ray_o,
+                           madrona::math::Vector3 inv_d,
+                           float t_max)
+{
+    if (aabb.pMin.x > aabb.pMax.x) {
+        return INFINITY;
+    }
+
+    float tx1 = (aabb.pMin.x - ray_o.x) * inv_d.x;
+    float tx2 = (aabb.pMax.x - ray_o.x) * inv_d.x;
+    float ty1 = (aabb.pMin.y - ray_o.y) * inv_d.y;
+    float ty2 = (aabb.pMax.y - ray_o.y) * inv_d.y;
+    float tz1 = (aabb.pMin.z - ray_o.z) * inv_d.z;
+    float tz2 = (aabb.pMax.z - ray_o.z) * inv_d.z;
+
+    float t_near = fmaxf(fmaxf(fminf(tx1, tx2), fminf(ty1, ty2)),
+                         fminf(tz1, tz2));
+    float t_far = fminf(fminf(fmaxf(tx1, tx2), fmaxf(ty1, ty2)),
+                        fmaxf(tz1, tz2));
+
+    if (t_near > t_far || t_far < 0.f || t_near >= t_max) {
+        return INFINITY;
+    }
+
+    return t_near;
+}
+
+inline madrona::math::Vector3 invDir(madrona::math::Vector3 d)
+{
+    return { 1.f / d.x, 1.f / d.y, 1.f / d.z };
+}
+
+// Walks one of the implicit trees, calling leaf_fn(leaf_idx, t_entry, t_max)
+// for every leaf whose bounds the ray enters before t_max. leaf_fn returns
+// the new t_max.
+template <CountT num_leaves, typename Fn>
+inline void traverse(const madrona::math::AABB *nodes,
+                     madrona::math::Vector3 ray_o,
+                     madrona::math::Vector3 inv_d,
+                     float &t_max,
+                     Fn &&leaf_fn)
+{
+    constexpr CountT first_leaf = num_leaves - 1;
+
+    int32_t stack[RaycastScene::maxTraversalDepth + 1];
+    CountT stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        int32_t node_idx = stack[--stack_size];
+
+        float t_entry = intersectAABB(nodes[node_idx], ray_o, inv_d, t_max);
+        if (t_entry == INFINITY) {
+            continue;
+        }
+
+        if (node_idx >= first_leaf) {
+            t_max = leaf_fn(node_idx - first_leaf, t_entry, t_max);
+        } else {
+            stack[stack_size++] = 2 * node_idx + 2;
+            stack[stack_size++] = 2 * node_idx + 1;
+        }
+    }
+}
+
+}
+
+inline Entity traceRaycastScene(const RaycastScene &scene,
+                                madrona::math::Vector3 ray_o,
+                                madrona::math::Vector3 ray_d,
+                                float *out_hit_t,
+                                float t_max)
+{
+    using namespace madrona::math;
+
+    Vector3 inv_d = raycast::invDir(ray_d);
+    Entity hit_entity = Entity::none();
+
+    // Static leaves are exact, so the leaf bounds test done by traverse
+    // is the intersection test. Rays starting inside a box skip it.
+    raycast::traverse<RaycastScene::numStaticLeaves>(
+        scene.staticNodes, ray_o, inv_d, t_max,
+        [&](CountT leaf_idx, float t_entry, float cur_t_max) {
+            if (t_entry <= 0.f) {
+                return cur_t_max;
+            }
+
+            hit_entity = scene.staticEntities[leaf_idx];
+            return t_entry;
+        });
+
+    raycast::traverse<RaycastScene::numDynamicLeaves>(
+        scene.dynamicNodes, ray_o, inv_d, t_max,
+        [&](CountT leaf_idx, float, float cur_t_max) {
+            const RaycastScene::Box &box = scene.dynamicBoxes[leaf_idx];
+
+            // Intersect in the box's local frame
+            Quat to_local = box.rot.inv();
+            Vector3 local_o = to_local.rotateVec(ray_o - box.center);
+            Vector3 local_d = to_local.rotateVec(ray_d);
+
+            AABB local_box {
+                .pMin = -box.halfExtents,
+                .pMax = box.halfExtents,
+            };
+
+            float t = raycast::intersectAABB(local_box, local_o,
+                raycast::invDir(local_d), cur_t_max);
+
+            if (t <= 0.f || t == INFINITY) {
+                return cur_t_max;
+            }
+
+            hit_entity = scene.dynamicEntities[leaf_idx];
+            return t;
+        });
+
+    *out_hit_t = t_max;
+    return hit_entity;
+}
+
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "raycast.hpp"
+#include "simd.hpp"
+
+namespace madEscape {
+
+namespace raycast {
+
+// Per-lane state of a packet of simd::floatLanes rays sharing one origin
+struct RayPacket {
+    madrona::math::Vector3 o;
+    simd::Float8 dx;
+    simd::Float8 dy;
+    simd::Float8 dz;
+    simd::Float8 invDx;
+    simd::Float8 invDy;
+    simd::Float8 invDz;
+    simd::Float8 tMax;
+    // Index of the closest leaf hit so far: static leaf i is i, dynamic leaf
+    // i is numStaticLeaves + i and -1 is no hit. Stored as float so select
+    // can update it.
+    simd::Float8 hitLeaf;
+};
+
+// Lane-wise version of intersectAABB (src/raycast.inl) for rays starting at
+// ray_o. Returns each lane's entry distance and sets out_hit for the lanes
+// that enter the box before their t_max.
+inline simd::Float8 intersectAABBPacket(const madrona::math::AABB &aabb,
+                                        madrona::math::Vector3 ray_o,
+                                        simd::Float8 inv_dx,
+                                        simd::Float8 inv_dy,
+                                        simd::Float8 inv_dz,
+                                        simd::Float8 t_max,
+                                        simd::Float8 *out_hit)
+{
+    using namespace simd;
+
+    Float8 tx1 = set1(aabb.pMin.x - ray_o.x) * inv_dx;
+    Float8 tx2 = set1(aabb.pMax.x - ray_o.x) * inv_dx;
+    Float8 ty1 = set1(aabb.pMin.y - ray_o.y) * inv_dy;
+    Float8 ty2 = set1(aabb.pMax.y - ray_o.y) * inv_dy;
+    Float8 tz1 = set1(aabb.pMin.z - ray_o.z) * inv_dz;
+    Float8 tz2 = set1(aabb.pMax.z - ray_o.z) * inv_dz;
+
+    Float8 t_near = max(max(min(tx1, tx2), min(ty1, ty2)), min(tz1, tz2));
+    Float8 t_far = min(min(max(tx1, tx2), max(ty1, ty2)), max(tz1, tz2));
+
+    *out_hit = lessEqual(t_near, t_far) & lessEqual(set1(0.f), t_far) &
+        lessThan(t_near, t_max);
+
+    return t_near;
+}
+
+// 2D slab test for horizontal rays against a rectangle given relative to
+// the rays' origin. Same arithmetic as intersectAABBPacket without the z
+// slab, which doesn't constrain rays whose height is inside the box.
+inline simd::Float8 intersectRectPacket(float rel_min_x,
+                                        float rel_min_y,
+                                        float rel_max_x,
+                                        float rel_max_y,
+                                        simd::Float8 inv_dx,
+                                        simd::Float8 inv_dy,
+                                        simd::Float8 t_max,
+                                        simd::Float8 *out_hit)
+{
+    using namespace simd;
+
+    Float8 tx1 = set1(rel_min_x) * inv_dx;
+    Float8 tx2 = set1(rel_max_x) * inv_dx;
+    Float8 ty1 = set1(rel_min_y) * inv_dy;
+    Float8 ty2 = set1(rel_max_y) * inv_dy;
+
+    Float8 t_near = max(min(tx1, tx2), min(ty1, ty2));
+    Float8 t_far = min(max(tx1, tx2), max(ty1, ty2));
+
+    *out_hit = lessEqual(t_near, t_far) & lessEqual(set1(0.f), t_far) &
+        lessThan(t_near, t_max);
+
+    return t_near;
+}
+
+// Lane-wise ray / oriented box test, in the box's local frame. The origin
+// is shared by every lane so only the directions need the SIMD transform.
+// Lanes starting inside the box miss it.
+inline simd::Float8 intersectBoxPacket(const RaycastScene::Box &box,
+                                       const RayPacket &packet,
+                                       simd::Float8 *out_hit)
+{
+    using namespace madrona::math;
+    using namespace simd;
+
+    Quat to_local = box.rot.inv();
+    Vector3 local_o = to_local.rotateVec(packet.o - box.center);
+
+    const Quat &q = to_local;
+    Float8 m00 = set1(1.f - 2.f * (q.y * q.y + q.z * q.z));
+    Float8 m01 = set1(2.f * (q.x * q.y - q.w * q.z));
+    Float8 m02 = set1(2.f * (q.x * q.z + q.w * q.y));
+    Float8 m10 = set1(2.f * (q.x * q.y + q.w * q.z));
+    Float8 m11 = set1(1.f - 2.f * (q.x * q.x + q.z * q.z));
+    Float8 m12 = set1(2.f * (q.y * q.z - q.w * q.x));
+    Float8 m20 = set1(2.f * (q.x * q.z - q.w * q.y));
+    Float8 m21 = set1(2.f * (q.y * q.z + q.w * q.x));
+    Float8 m22 = set1(1.f - 2.f * (q.x * q.x + q.y * q.y));
+
+    Float8 local_dx = m00 * packet.dx + m01 * packet.dy + m02 * packet.dz;
+    Float8 local_dy = m10 * packet.dx + m11 * packet.dy + m12 * packet.dz;
+    Float8 local_dz = m20 * packet.dx + m21 * packet.dy + m22 * packet.dz;
+
+    AABB local_box {
+        .pMin = -box.halfExtents,
+        .pMax = box.halfExtents,
+    };
+
+    Float8 hit;
+    Float8 t = intersectAABBPacket(local_box, local_o,
+        set1(1.f) / local_dx, set1(1.f) / local_dy, set1(1.f) / local_dz,
+        packet.tMax, &hit);
+
+    *out_hit = hit & lessThan(set1(0.f), t);
+
+    return t;
+}
+
+// Writes out each lane's hit entity and distance
+inline void resolveHits(const RaycastScene &scene,
+                        const RayPacket &packet,
+                        Entity *out_hit_entities,
+                        float *out_hit_ts)
+{
+    float hit_leaves[simd::floatLanes];
+    simd::store(hit_leaves, packet.hitLeaf);
+    simd::store(out_hit_ts, packet.tMax);
+
+    for (CountT i = 0; i < simd::floatLanes; i++) {
+        CountT leaf_idx = CountT(hit_leaves[i]);
+
+        if (leaf_idx < 0) {
+            out_hit_entities[i] = Entity::none();
+        } else if (leaf_idx < RaycastScene::numStaticLeaves) {
+            out_hit_entities[i] = scene.staticEntities[leaf_idx];
+        } else {
+            out_hit_entities[i] = scene.dynamicEntities[
+                leaf_idx - RaycastScene::numStaticLeaves];
+        }
+    }
+}
+
+// Packet version of traverse (src/raycast.inl): walks the tree once for
+// all lanes, descending into a node if any lane enters it before its own
+// t_max. leaf_fn(leaf_idx, t_entry, hit_mask) is responsible for updating
+// packet.tMax. With planar set, the rays must be horizontal and nodes are
+// tested as 2D rectangles once their z range is known to contain them.
+template <CountT num_leaves, bool planar, typename Fn>
+inline void traversePacket(const madrona::math::AABB *nodes,
+                           RayPacket &packet,
+                           Fn &&leaf_fn)
+{
+    constexpr CountT first_leaf = num_leaves - 1;
+
+    int32_t stack[RaycastScene::maxTraversalDepth + 1];
+    CountT stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        int32_t node_idx = stack[--stack_size];
+
+        const madrona::math::AABB &node = nodes[node_idx];
+        if (node.pMin.x > node.pMax.x) {
+            continue;
+        }
+
+        simd::Float8 hit;
+        simd::Float8 t_entry;
+        if constexpr (planar) {
+            if (!(node.pMin.z < packet.o.z && packet.o.z < node.pMax.z)) {
+                continue;
+            }
+
+            t_entry = intersectRectPacket(
+                node.pMin.x - packet.o.x, node.pMin.y - packet.o.y,
+                node.pMax.x - packet.o.x, node.pMax.y - packet.o.y,
+                packet.invDx, packet.invDy, packet.tMax, &hit);
+        } else {
+            t_entry = intersectAABBPacket(node, packet.o, packet.invDx,
+                packet.invDy, packet.invDz, packet.tMax, &hit);
+        }
+
+        if (!simd::any(hit)) {
+            continue;
+        }
+
+        if (node_idx >= first_leaf) {
+            leaf_fn(node_idx - first_leaf, t_entry, hit);
+        } else {
+            stack[stack_size++] = 2 * node_idx + 2;
+            stack[stack_size++] = 2 * node_idx + 1;
+        }
+    }
+}
+
+}
+
+// Traces simd::floatLanes rays from ray_o with directions given as SoA
+// (ray_dx, ray_dy, ray_dz), walking each tree of the scene once for the
+// whole packet rather than once per ray. Per ray results are the same as
+// traceRaycastScene, up to rounding in the dynamic boxes' local frame
+// transform (a rotation matrix here, a quaternion there).
+inline void traceRaycastScenePacket(const RaycastScene &scene,
+                                    madrona::math::Vector3 ray_o,
+                                    const float *ray_dx,
+                                    const float *ray_dy,
+                                    const float *ray_dz,
+                                    float t_max,
+                                    Entity *out_hit_entities,
+                                    float *out_hit_ts)
+{
+    using namespace madrona::math;
+    using namespace simd;
+
+    raycast::RayPacket packet;
+    packet.o = ray_o;
+    packet.dx = load(ray_dx);
+    packet.dy = load(ray_dy);
+    packet.dz = load(ray_dz);
+    packet.invDx = set1(1.f) / packet.dx;
+    packet.invDy = set1(1.f) / packet.dy;
+    packet.invDz = set1(1.f) / packet.dz;
+    packet.tMax = set1(t_max);
+    packet.hitLeaf = set1(-1.f);
+
+    // Static leaves are exact, lanes starting inside a box skip it
+    raycast::traversePacket<RaycastScene::numStaticLeaves, false>(
+        scene.staticNodes, packet,
+        [&](CountT leaf_idx, Float8 t_entry, Float8 hit) {
+            hit = hit & lessThan(set1(0.f), t_entry);
+
+            packet.tMax = select(hit, t_entry, packet.tMax);
+            packet.hitLeaf = select(hit, set1(float(leaf_idx)),
+                                    packet.hitLeaf);
+        });
+
+    raycast::traversePacket<RaycastScene::numDynamicLeaves, false>(
+        scene.dynamicNodes, packet,
+        [&](CountT leaf_idx, Float8, Float8 hit) {
+            Float8 box_hit;
+            Float8 t = raycast::intersectBoxPacket(
+                scene.dynamicBoxes[leaf_idx], packet, &box_hit);
+
+            hit = hit & box_hit;
+
+            packet.tMax = select(hit, t, packet.tMax);
+            packet.hitLeaf = select(hit,
+                set1(float(RaycastScene::numStaticLeaves + leaf_idx)),
+                packet.hitLeaf);
+        });
+
+    raycast::resolveHits(scene, packet, out_hit_entities, out_hit_ts);
+}
+
+// Variant of traceRaycastScenePacket for horizontal rays (ray_dz == 0),
+// which is all lidar casts. Nodes and boxes that straddle the rays' height
+// are tested as 2D rectangles, and ones that don't are skipped outright.
+// Dynamic boxes that are only rotated around Z are tested as rectangles in
+// their local frame; others (eg a tipped over cube) take the 3D test.
+// Results match traceRaycastScenePacket.
+inline void traceRaycastScenePlanar(const RaycastScene &scene,
+                                    madrona::math::Vector3 ray_o,
+                                    const float *ray_dx,
+                                    const float *ray_dy,
+                                    float t_max,
+                                    Entity *out_hit_entities,
+                                    float *out_hit_ts)
+{
+    using namespace madrona::math;
+    using namespace simd;
+
+    raycast::RayPacket packet;
+    packet.o = ray_o;
+    packet.dx = load(ray_dx);
+    packet.dy = load(ray_dy);
+    packet.dz = set1(0.f);
+    packet.invDx = set1(1.f) / packet.dx;
+    packet.invDy = set1(1.f) / packet.dy;
+    packet.invDz = set1(1.f) / packet.dz;
+    packet.tMax = set1(t_max);
+    packet.hitLeaf = set1(-1.f);
+
+    // As in the 3D version, the static leaf bounds test is the intersection
+    raycast::traversePacket<RaycastScene::numStaticLeaves, true>(
+        scene.staticNodes, packet,
+        [&](CountT leaf_idx, Float8 t_entry, Float8 hit) {
+            hit = hit & lessThan(set1(0.f), t_entry);
+
+            packet.tMax = select(hit, t_entry, packet.tMax);
+            packet.hitLeaf = select(hit, set1(float(leaf_idx)),
+                                    packet.hitLeaf);
+        });
+
+    raycast::traversePacket<RaycastScene::numDynamicLeaves, true>(
+        scene.dynamicNodes, packet,
+        [&](CountT leaf_idx, Float8, Float8 hit) {
+            const RaycastScene::Box &box = scene.dynamicBoxes[leaf_idx];
+
+            Float8 box_hit;
+            Float8 t;
+            if (box.rot.x == 0.f && box.rot.y == 0.f) {
+                Quat to_local = box.rot.inv();
+                Vector3 local_o = to_local.rotateVec(ray_o - box.center);
+                if (!(-box.halfExtents.z < local_o.z &&
+                        local_o.z < box.halfExtents.z)) {
+                    return;
+                }
+
+                Float8 cos_yaw = set1(1.f - 2.f * to_local.z * to_local.z);
+                Float8 sin_yaw = set1(2.f * to_local.w * to_local.z);
+
+                Float8 local_dx = cos_yaw * packet.dx - sin_yaw * packet.dy;
+                Float8 local_dy = sin_yaw * packet.dx + cos_yaw * packet.dy;
+
+                t = raycast::intersectRectPacket(
+                    -box.halfExtents.x - local_o.x,
+                    -box.halfExtents.y - local_o.y,
+                    box.halfExtents.x - local_o.x,
+                    box.halfExtents.y - local_o.y,
+                    set1(1.f) / local_dx, set1(1.f) / local_dy,
+                    packet.tMax, &box_hit);
+
+                box_hit = box_hit & lessThan(set1(0.f), t);
+            } else {
+                t = raycast::intersectBoxPacket(box, packet, &box_hit);
+            }
+
+            hit = hit & box_hit;
+
+            packet.tMax = select(hit, t, packet.tMax);
+            packet.hitLeaf = select(hit,
+                set1(float(RaycastScene::numStaticLeaves + leaf_idx)),
+                packet.hitLeaf);
+        });
+
+    raycast::resolveHits(scene, packet, out_hit_entities, out_hit_ts);
+}
+
+}
@@ -2,9 +2,21 @@
 
 #include "sim.hpp"
 #include "level_gen.hpp"
+#include "fast_math.hpp"
+#include "lidar_dirs.hpp"
+#include "float16.hpp"
+
+#ifndef MADRONA_GPU_MODE
+#include "obs_simd.hpp"
+#include "raycast_simd.hpp"
+#endif
 
 #include <algorithm>
 
+#ifndef MADRONA_GPU_MODE
+#include <chrono>
+#endif
+
 using namespace madrona;
 using namespace madrona::math;
 using namespace madrona::phys;
@@ -29,6 +41,7 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
     registry.registerComponent<GrabState>();
     registry.registerComponent<Progress>();
     registry.registerComponent<OtherAgents>();
+    registry.registerComponent<AgentID>();
     registry.registerComponent<PartnerObservations>();
     registry.registerComponent<RoomEntityObservations>();
     registry.registerComponent<DoorObservation>();
@@ -38,9 +51,23 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
     registry.registerComponent<Lidar>();
     registry.registerComponent<StepsRemaining>();
     registry.registerComponent<EntityType>();
+    registry.registerComponent<SelfObservationF16>();
+    registry.registerComponent<PartnerObservationsF16>();
+    registry.registerComponent<RoomEntityObservationsF16>();
+    registry.registerComponent<DoorObservationF16>();
+    registry.registerComponent<LidarU8>();
+    registry.registerComponent<FusedObservation>();
+    registry.registerComponent<ObservationFrames>();
+    registry.registerComponent<ObservationFrameHead>();
 
     registry.registerSingleton<WorldReset>();
+    registry.registerSingleton<LevelSelect>();
+    registry.registerSingleton<RaycastScene>();
     registry.registerSingleton<LevelState>();
+    registry.registerSingleton<TaskTimings>();
+    registry.registerSingleton<StepRepeat>();
+    registry.registerSingleton<ButtonPresses>();
+    registry.registerSingleton<MovingDoors>();
 
     registry.registerArchetype<Agent>();
     registry.registerArchetype<PhysicsEntity>();
@@ -52,6 +79,12 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
 
     registry.exportSingleton<WorldReset>(
         (uint32_t)ExportID::Reset);
+    registry.exportSingleton<LevelSelect>(
+        (uint32_t)ExportID::LevelSelect);
+    registry.exportSingleton<TaskTimings>(
+        (uint32_t)ExportID::TaskTimings);
+    registry.exportSingleton<ButtonPresses>(
+        (uint32_t)ExportID::ButtonPresses);
     registry.exportColumn<Agent, Action>(
         (uint32_t)ExportID::Action);
     registry.exportColumn<Agent, SelfObservation>(
@@ -70,10 +103,35 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
         (uint32_t)ExportID::Reward);
     registry.exportColumn<Agent, Done>(
         (uint32_t)ExportID::Done);
+    registry.exportColumn<Agent, SelfObservationF16>(
+        (uint32_t)ExportID::SelfObservationF16);
+    registry.exportColumn<Agent, PartnerObservationsF16>(
+        (uint32_t)ExportID::PartnerObservationsF16);
+    registry.exportColumn<Agent, RoomEntityObservationsF16>(
+        (uint32_t)ExportID::RoomEntityObservationsF16);
+    registry.exportColumn<Agent, DoorObservationF16>(
+        (uint32_t)ExportID::DoorObservationF16);
+    registry.exportColumn<Agent, LidarU8>(
+        (uint32_t)ExportID::LidarU8);
+    registry.exportColumn<Agent, FusedObservation>(
+        (uint32_t)ExportID::FusedObservation);
+    registry.exportColumn<Agent, ObservationFrames>(
+        (uint32_t)ExportID::ObservationFrames);
+    registry.exportColumn<Agent, ObservationFrameHead>(
+        (uint32_t)ExportID::ObservationFrameHead);
 }
 
 static inline void cleanupWorld(Engine &ctx)
 {
+    // Pooled level entities are simply re-initialized by the next call to
+    // generateWorld, so there is nothing to destroy.
+    if (ctx.data().useEntityPool) {
+        LevelEntityPool &pool = ctx.data().entityPool;
+        pool.numCubesUsed = 0;
+        pool.numButtonsUsed = 0;
+        return;
+    }
+
     // Destroy current level entities
     LevelState &level = ctx.singleton<LevelState>();
     for (CountT i = 0; i < consts::numRooms; i++) {
@@ -100,6 +158,17 @@ static inline void initWorld(Engine &ctx)
 
     // Defined in src/level_gen.hpp / src/level_gen.cpp
     generateWorld(ctx);
+
+    // Start the episode with an empty frame stack. The head points at the
+    // last slot so the first frame pushed by a step lands in slot 0.
+    if (ctx.data().frameStacking) {
+        for (CountT i = 0; i < consts::numAgents; i++) {
+            Entity agent = ctx.data().agents[i];
+            ctx.get<ObservationFrames>(agent) = {};
+            ctx.get<ObservationFrameHead>(agent).idx =
+                consts::numStackedFrames - 1;
+        }
+    }
 }
 
 // This system runs each frame and checks if the current episode is complete
@@ -109,12 +178,13 @@ static inline void initWorld(Engine &ctx)
 // If a reset is needed, cleanup the existing world and generate a new one.
 inline void resetSystem(Engine &ctx, WorldReset &reset)
 {
-    int32_t should_reset = reset.reset;
+    int32_t should_reset = reset.reset != 0 ? 1 : 0;
     if (ctx.data().autoReset) {
+        // Not Done, which stays latched for the rest of a
+        // Manager::step(num_steps) call (see StepRepeat)
+        const StepRepeat &step_repeat = ctx.singleton<StepRepeat>();
         for (CountT i = 0; i < consts::numAgents; i++) {
-            Entity agent = ctx.data().agents[i];
-            Done done = ctx.get<Done>(agent);
-            if (done.v) {
+            if (step_repeat.stepDone[i]) {
                 should_reset = 1;
             }
         }
@@ -128,6 +198,34 @@ inline void resetSystem(Engine &ctx, WorldReset &reset)
     }
 }
 
+// Zero reward and no done for an episode started outside of a step
+static inline void clearStepOutputs(Engine &ctx)
+{
+    StepRepeat &step_repeat = ctx.singleton<StepRepeat>();
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        Entity agent = ctx.data().agents[i];
+        ctx.get<Reward>(agent).v = 0.f;
+        ctx.get<Done>(agent).v = 0;
+        step_repeat.stepDone[i] = 0;
+    }
+}
+
+// Reset task graph counterpart of resetSystem: only regenerates worlds
+// whose reset was explicitly requested through WorldReset. There is no
+// step in flight, so the new episode starts with zero reward and no done.
+inline void externalResetSystem(Engine &ctx, WorldReset &reset)
+{
+    if (reset.reset == 0) {
+        return;
+    }
+
+    reset.reset = 0;
+
+    cleanupWorld(ctx);
+    initWorld(ctx);
+    clearStepOutputs(ctx);
+}
+
 // Translates discrete actions from the Action component to forces
 // used by the physics simulation.
 inline void movementSystem(Engine &,
@@ -149,8 +247,8 @@ inline void movementSystem(Engine &,
 
     float move_angle = float(action.moveAngle) * move_angle_per_bucket;
 
-    float f_x = move_amount * sinf(move_angle);
-    float f_y = move_amount * cosf(move_angle);
+    float f_x = move_amount * trig::sin(move_angle);
+    float f_y = move_amount * trig::cos(move_angle);
 
     constexpr float turn_delta_per_bucket = 
         turn_max / (consts::numTurnBuckets / 2);
@@ -170,7 +268,9 @@ inline void grabSystem(Engine &ctx,
                        Action action,
                        GrabState &grab)
 {
-    if (action.grab == 0) {
+    // A held grab action only triggers on the first step of
+    // Manager::step(num_steps), rather than toggling the grab every step
+    if (action.grab == 0 || ctx.singleton<StepRepeat>().stepIdx > 0) {
         return;
     }
 
@@ -183,16 +283,21 @@ inline void grabSystem(Engine &ctx,
         return;
     } 
 
-    // Get the per-world BVH singleton component
-    auto &bvh = ctx.singleton<broadphase::BVH>();
     float hit_t;
     Vector3 hit_normal;
 
     Vector3 ray_o = pos + 0.5f * math::up;
     Vector3 ray_d = rot.rotateVec(math::fwd);
 
-    Entity grab_entity =
-        bvh.traceRay(ray_o, ray_d, &hit_t, &hit_normal, 2.0f);
+    Entity grab_entity;
+    if (ctx.data().useRaycastScene) {
+        grab_entity = traceRaycastScene(ctx.singleton<RaycastScene>(),
+            ray_o, ray_d, &hit_t, 2.0f);
+    } else {
+        // Get the per-world BVH singleton component
+        auto &bvh = ctx.singleton<broadphase::BVH>();
+        grab_entity = bvh.traceRay(ray_o, ray_d, &hit_t, &hit_normal, 2.0f);
+    }
 
     if (grab_entity == Entity::none()) {
         return;
@@ -226,72 +331,266 @@ inline void grabSystem(Engine &ctx,
         e, grab_entity, attach1, attach2, r1, r2, separation);
 }
 
-// Animates the doors opening and closing based on OpenState
-inline void setDoorPositionSystem(Engine &,
-                                  Position &pos,
-                                  OpenState &open_state)
+// Refits the dynamic half of RaycastScene to the current entity transforms
+inline void raycastRefitSystem(Engine &ctx, RaycastScene &scene)
 {
-    if (open_state.isOpen) {
-        // Put underground
-        if (pos.z > -4.5f) {
-            pos.z += -consts::doorSpeed * consts::deltaT;
-        }
-    }
-    else if (pos.z < 0.0f) {
-        // Put back on surface
-        pos.z += consts::doorSpeed * consts::deltaT;
+    refitRaycastScene(ctx, scene);
+}
+
+// Moves each body's BVH leaf to its current transform, for bvhUpdateSystem
+inline void bvhLeafSystem(Engine &ctx,
+                          broadphase::LeafID leaf_id,
+                          Position pos,
+                          Rotation rot,
+                          Scale scale,
+                          ObjectID obj_id,
+                          Velocity vel)
+{
+    auto &bvh = ctx.singleton<broadphase::BVH>();
+    AABB obj_aabb = ctx.data().rigidBodyObjMgr->rigidBodyAABBs[obj_id.idx];
+
+    bvh.updateLeafPosition(leaf_id, pos, rot, scale, vel.linear, obj_aabb);
+}
+
+// Refits the BVH to the leaves moved by bvhLeafSystem. PhysicsSystem::reset
+// makes the next update of a world's BVH a full rebuild, so only the worlds
+// regenerated since the last update build a new tree.
+inline void bvhUpdateSystem(Engine &, broadphase::BVH &bvh)
+{
+    bvh.updateTree();
+}
+
+// Animates the doors opening and closing based on OpenState. Doors at rest
+// are left untouched, so only the doors in MovingDoors are visited and
+// worlds where no door moves return right away.
+inline void setDoorPositionSystem(Engine &ctx, MovingDoors &moving)
+{
+    if (moving.mask == 0) {
+        return;
     }
-    
-    if (pos.z >= 0.0f) {
-        pos.z = 0.0f;
+
+    const LevelState &level = ctx.singleton<LevelState>();
+    uint32_t still_moving = 0;
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        if ((moving.mask & (1u << i)) == 0) {
+            continue;
+        }
+
+        Entity door = level.rooms[i].door;
+        Position &pos = ctx.get<Position>(door);
+
+        bool at_rest;
+        if (ctx.get<OpenState>(door).isOpen) {
+            // Put underground
+            if (pos.z > -4.5f) {
+                pos.z += -consts::doorSpeed * consts::deltaT;
+            }
+            at_rest = pos.z <= -4.5f;
+        } else {
+            // Put back on surface
+            if (pos.z < 0.0f) {
+                pos.z = fminf(pos.z + consts::doorSpeed * consts::deltaT,
+                              0.0f);
+            }
+            at_rest = pos.z >= 0.0f;
+        }
+
+        if (!at_rest) {
+            still_moving |= 1u << i;
+        }
     }
+
+    moving.mask = still_moving;
 }
 
 
-// Checks if there is an entity standing on the button and updates
-// ButtonState if so.
-inline void buttonSystem(Engine &ctx,
-                         Position pos,
-                         ButtonState &state)
-{
-    AABB button_aabb {
-        .pMin = pos + Vector3 { 
-            -consts::buttonWidth / 2.f, 
-            -consts::buttonWidth / 2.f,
-            0.f,
-        },
-        .pMax = pos + Vector3 { 
-            consts::buttonWidth / 2.f, 
-            consts::buttonWidth / 2.f,
-            0.25f
-        },
+// Grid cell of v along one axis of a grid starting at origin, clamped to
+// the grid. Also handles the infinite bounds of the floor plane.
+static inline CountT buttonGridCell(float v, float origin, float cell_size,
+                                    CountT num_cells)
+{
+    float cell = (v - origin) / cell_size;
+    cell = fminf(fmaxf(cell, 0.f), float(num_cells - 1));
+    return CountT(cell);
+}
+
+// Checks if there is an entity standing on each button of the level and
+// updates ButtonState and ButtonPresses accordingly. Instead of a BVH query
+// per button, the CollisionAABB of every physics body (the bounds the BVH is
+// built from) is binned once into a uniform grid over the level, and each
+// button only tests the bodies of the cells under it, with the same overlap
+// test. With Sim::bvhButtonQuery each button instead runs the BVH query the
+// grid replaced, which sim_equivalence_test compares the grid against.
+inline void buttonSystem(Engine &ctx, const LevelState &level)
+{
+    constexpr float cell_size = 4.f;
+    constexpr float grid_min_x = -consts::worldWidth / 2.f;
+    constexpr float grid_min_y = 0.f;
+    constexpr CountT grid_width = CountT(consts::worldWidth / cell_size);
+    constexpr CountT grid_length = CountT(consts::worldLength / cell_size);
+
+    // Floor, borders, agents, then each room's walls, door and entities
+    constexpr CountT max_bodies = 4 + consts::numAgents +
+        consts::numRooms * (3 + consts::maxEntitiesPerRoom);
+    static_assert(max_bodies <= 64);
+
+    const bool bvh_query = ctx.data().bvhButtonQuery;
+
+    AABB body_aabbs[max_bodies];
+    CountT num_bodies = 0;
+    uint64_t cells[grid_length][grid_width] = {};
+
+    auto addBody = [&](Entity e) {
+        AABB aabb = ctx.get<CollisionAABB>(e);
+
+        CountT min_x = buttonGridCell(
+            aabb.pMin.x, grid_min_x, cell_size, grid_width);
+        CountT max_x = buttonGridCell(
+            aabb.pMax.x, grid_min_x, cell_size, grid_width);
+        CountT min_y = buttonGridCell(
+            aabb.pMin.y, grid_min_y, cell_size, grid_length);
+        CountT max_y = buttonGridCell(
+            aabb.pMax.y, grid_min_y, cell_size, grid_length);
+
+        for (CountT y = min_y; y <= max_y; y++) {
+            for (CountT x = min_x; x <= max_x; x++) {
+                cells[y][x] |= 1ull << num_bodies;
+            }
+        }
+
+        body_aabbs[num_bodies++] = aabb;
     };
 
-    bool button_pressed = false;
-    PhysicsSystem::findEntitiesWithinAABB(
-            ctx, button_aabb, [&](Entity) {
-        button_pressed = true;
-    });
+    if (!bvh_query) {
+        addBody(ctx.data().floorPlane);
+        for (CountT i = 0; i < 3; i++) {
+            addBody(ctx.data().borders[i]);
+        }
+        for (CountT i = 0; i < consts::numAgents; i++) {
+            addBody(ctx.data().agents[i]);
+        }
+
+        for (CountT i = 0; i < consts::numRooms; i++) {
+            const Room &room = level.rooms[i];
+            addBody(room.walls[0]);
+            addBody(room.walls[1]);
+            addBody(room.door);
+
+            // Buttons have no collision body
+            for (CountT j = 0; j < consts::maxEntitiesPerRoom; j++) {
+                Entity e = room.entities[j];
+                if (e != Entity::none() &&
+                        ctx.get<EntityType>(e) != EntityType::Button) {
+                    addBody(e);
+                }
+            }
+        }
+    }
+
+    uint32_t pressed = 0;
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        for (CountT j = 0; j < consts::maxButtonsPerRoom; j++) {
+            Entity button = level.rooms[i].entities[j];
+            if (button == Entity::none() ||
+                    ctx.get<EntityType>(button) != EntityType::Button) {
+                continue;
+            }
 
-    state.isPressed = button_pressed;
+            Vector3 pos = ctx.get<Position>(button);
+            AABB button_aabb {
+                .pMin = pos + Vector3 {
+                    -consts::buttonWidth / 2.f,
+                    -consts::buttonWidth / 2.f,
+                    0.f,
+                },
+                .pMax = pos + Vector3 {
+                    consts::buttonWidth / 2.f,
+                    consts::buttonWidth / 2.f,
+                    0.25f
+                },
+            };
+
+            bool button_pressed = false;
+            if (bvh_query) {
+                PhysicsSystem::findEntitiesWithinAABB(
+                        ctx, button_aabb, [&](Entity) {
+                    button_pressed = true;
+                });
+            } else {
+                CountT min_x = buttonGridCell(
+                    button_aabb.pMin.x, grid_min_x, cell_size, grid_width);
+                CountT max_x = buttonGridCell(
+                    button_aabb.pMax.x, grid_min_x, cell_size, grid_width);
+                CountT min_y = buttonGridCell(
+                    button_aabb.pMin.y, grid_min_y, cell_size, grid_length);
+                CountT max_y = buttonGridCell(
+                    button_aabb.pMax.y, grid_min_y, cell_size, grid_length);
+
+                uint64_t candidates = 0;
+                for (CountT y = min_y; y <= max_y; y++) {
+                    for (CountT x = min_x; x <= max_x; x++) {
+                        candidates |= cells[y][x];
+                    }
+                }
+
+                for (CountT k = 0; k < num_bodies; k++) {
+                    if ((candidates & (1ull << k)) != 0 &&
+                            body_aabbs[k].overlaps(button_aabb)) {
+                        button_pressed = true;
+                    }
+                }
+            }
+
+            ctx.get<ButtonState>(button).isPressed = button_pressed;
+            if (button_pressed) {
+                pressed |= buttonBit(i, j);
+            }
+        }
+    }
+
+    ctx.singleton<ButtonPresses>().pressed = pressed;
+
+    // Pooled buttons the level didn't use are parked away from everything
+    if (ctx.data().useEntityPool) {
+        const LevelEntityPool &pool = ctx.data().entityPool;
+        for (CountT i = pool.numButtonsUsed;
+             i < consts::numRooms * consts::maxButtonsPerRoom; i++) {
+            ctx.get<ButtonState>(pool.buttons[i]).isPressed = false;
+        }
+    }
 }
 
-// Check if all the buttons linked to the door are pressed and open if so.
-// Optionally, close the door if the buttons aren't pressed.
-inline void doorOpenSystem(Engine &ctx,
-                           OpenState &open_state,
-                           const DoorProperties &props)
+// Check if all the buttons linked to each door are pressed and open it if
+// so. Optionally, close the door if the buttons aren't pressed. A door's
+// state only depends on the pressed buttons, so nothing is done on steps
+// where no button changed.
+inline void doorOpenSystem(Engine &ctx, ButtonPresses &presses)
 {
-    bool all_pressed = true;
-    for (int32_t i = 0; i < props.numButtons; i++) {
-        Entity button = props.buttons[i];
-        all_pressed = all_pressed && ctx.get<ButtonState>(button).isPressed;
+    if (presses.pressed == presses.doorsEvaluated) {
+        return;
     }
+    presses.doorsEvaluated = presses.pressed;
+
+    const LevelState &level = ctx.singleton<LevelState>();
+    MovingDoors &moving = ctx.singleton<MovingDoors>();
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        Entity door = level.rooms[i].door;
+        const DoorProperties &props = ctx.get<DoorProperties>(door);
+        OpenState &open_state = ctx.get<OpenState>(door);
+        bool was_open = open_state.isOpen;
+
+        bool all_pressed =
+            (presses.pressed & props.buttonMask) == props.buttonMask;
+
+        if (all_pressed) {
+            open_state.isOpen = true;
+        } else if (!props.isPersistent) {
+            open_state.isOpen = false;
+        }
 
-    if (all_pressed) {
-        open_state.isOpen = true;
-    } else if (!props.isPersistent) {
-        open_state.isOpen = false;
+        if (open_state.isOpen != was_open) {
+            moving.mask |= 1u << i;
+        }
     }
 }
 
@@ -308,6 +607,13 @@ inline void agentZeroVelSystem(Engine &,
     vel.angular = Vector3::zero();
 }
 
+// Index of the room containing y, clamped to the rooms of the level
+static inline CountT roomIndex(float y)
+{
+    CountT room_idx = CountT(y / consts::roomLength);
+    return std::max(CountT(0), std::min(consts::numRooms - 1, room_idx));
+}
+
 static inline float distObs(float v)
 {
     return v / consts::worldLength;
@@ -331,7 +637,7 @@ static inline PolarObservation xyToPolar(Vector3 v)
     float r = xy.length();
 
     // Note that this is angle off y-forward
-    float theta = atan2f(xy.x, xy.y);
+    float theta = trig::atan2(xy.x, xy.y);
 
     return PolarObservation {
         .r = distObs(r),
@@ -348,9 +654,87 @@ static inline float computeZAngle(Quat q)
 {
     float siny_cosp = 2.f * (q.w * q.z + q.x * q.y);
     float cosy_cosp = 1.f - 2.f * (q.y * q.y + q.z * q.z);
-    return atan2f(siny_cosp, cosy_cosp);
+    return trig::atan2(siny_cosp, cosy_cosp);
 }
 
+#ifndef MADRONA_GPU_MODE
+// CPU path for the partner, room entity and door observations of
+// collectObservationsSystem: gathers the positions of every observed entity
+// into SIMD lanes and converts all of them to polar coordinates in one pass
+// (src/obs_simd.hpp).
+static inline void collectTargetObservationsSIMD(
+    Engine &ctx,
+    Vector3 pos,
+    Quat to_view,
+    const OtherAgents &other_agents,
+    const Room &room,
+    PartnerObservations &partner_obs,
+    RoomEntityObservations &room_ent_obs,
+    DoorObservation &door_obs)
+{
+    constexpr CountT partners_offset = 0;
+    constexpr CountT entities_offset = consts::numAgents - 1;
+    constexpr CountT door_offset =
+        entities_offset + consts::maxEntitiesPerRoom;
+    static_assert(door_offset < simd::floatLanes);
+
+    alignas(32) float dx[simd::floatLanes] = {};
+    alignas(32) float dy[simd::floatLanes] = {};
+    alignas(32) float dz[simd::floatLanes] = {};
+
+    auto gather = [&](CountT lane, Entity e) {
+        Vector3 to_e = ctx.get<Position>(e) - pos;
+        dx[lane] = to_e.x;
+        dy[lane] = to_e.y;
+        dz[lane] = to_e.z;
+    };
+
+    for (CountT i = 0; i < consts::numAgents - 1; i++) {
+        gather(partners_offset + i, other_agents.e[i]);
+    }
+
+    for (CountT i = 0; i < consts::maxEntitiesPerRoom; i++) {
+        if (room.entities[i] != Entity::none()) {
+            gather(entities_offset + i, room.entities[i]);
+        }
+    }
+
+    gather(door_offset, room.door);
+
+    alignas(32) float r[simd::floatLanes];
+    alignas(32) float theta[simd::floatLanes];
+    polarObservationsSIMD(dx, dy, dz, to_view, r, theta);
+
+    for (CountT i = 0; i < consts::numAgents - 1; i++) {
+        GrabState other_grab = ctx.get<GrabState>(other_agents.e[i]);
+
+        partner_obs.obs[i] = {
+            .polar = { r[partners_offset + i], theta[partners_offset + i] },
+            .isGrabbing = other_grab.constraintEntity != Entity::none() ?
+                1.f : 0.f,
+        };
+    }
+
+    for (CountT i = 0; i < consts::maxEntitiesPerRoom; i++) {
+        Entity entity = room.entities[i];
+
+        EntityObservation ob;
+        if (entity == Entity::none()) {
+            ob.polar = { 0.f, 1.f };
+            ob.encodedType = encodeType(EntityType::None);
+        } else {
+            ob.polar = { r[entities_offset + i], theta[entities_offset + i] };
+            ob.encodedType = encodeType(ctx.get<EntityType>(entity));
+        }
+
+        room_ent_obs.obs[i] = ob;
+    }
+
+    door_obs.polar = { r[door_offset], theta[door_offset] };
+    door_obs.isOpen = ctx.get<OpenState>(room.door).isOpen ? 1.f : 0.f;
+}
+#endif
+
 // This system packages all the egocentric observations together 
 // for the policy inputs.
 inline void collectObservationsSystem(Engine &ctx,
@@ -364,9 +748,7 @@ inline void collectObservationsSystem(Engine &ctx,
                                       RoomEntityObservations &room_ent_obs,
                                       DoorObservation &door_obs)
 {
-    CountT cur_room_idx = CountT(pos.y / consts::roomLength);
-    cur_room_idx = std::max(CountT(0), 
-        std::min(consts::numRooms - 1, cur_room_idx));
+    CountT cur_room_idx = roomIndex(pos.y);
 
     self_obs.roomX = pos.x / (consts::worldWidth / 2.f);
     self_obs.roomY = (pos.y - cur_room_idx * consts::roomLength) /
@@ -381,6 +763,17 @@ inline void collectObservationsSystem(Engine &ctx,
 
     Quat to_view = rot.inv();
 
+    const LevelState &level = ctx.singleton<LevelState>();
+    const Room &room = level.rooms[cur_room_idx];
+
+#ifndef MADRONA_GPU_MODE
+    if (ctx.data().simdObservations) {
+        collectTargetObservationsSIMD(ctx, pos, to_view, other_agents, room,
+            partner_obs, room_ent_obs, door_obs);
+        return;
+    }
+#endif
+
 #pragma unroll
     for (CountT i = 0; i < consts::numAgents - 1; i++) {
         Entity other = other_agents.e[i];
@@ -396,9 +789,6 @@ inline void collectObservationsSystem(Engine &ctx,
         };
     }
 
-    const LevelState &level = ctx.singleton<LevelState>();
-    const Room &room = level.rooms[cur_room_idx];
-
     for (CountT i = 0; i < consts::maxEntitiesPerRoom; i++) {
         Entity entity = room.entities[i];
 
@@ -435,26 +825,13 @@ inline void lidarSystem(Engine &ctx,
                         Lidar &lidar)
 {
     Vector3 pos = ctx.get<Position>(e);
-    Quat rot = ctx.get<Rotation>(e);
     auto &bvh = ctx.singleton<broadphase::BVH>();
+    const RaycastScene &raycast_scene = ctx.singleton<RaycastScene>();
+    bool use_raycast_scene = ctx.data().useRaycastScene;
 
-    Vector3 agent_fwd = rot.rotateVec(math::fwd);
-    Vector3 right = rot.rotateVec(math::right);
-
-    auto traceRay = [&](int32_t idx) {
-        float theta = 2.f * math::pi * (
-            float(idx) / float(consts::numLidarSamples)) + math::pi / 2.f;
-        float x = cosf(theta);
-        float y = sinf(theta);
-
-        Vector3 ray_dir = (x * right + y * agent_fwd).normalize();
-
-        float hit_t;
-        Vector3 hit_normal;
-        Entity hit_entity =
-            bvh.traceRay(pos + 0.5f * math::up, ray_dir, &hit_t,
-                         &hit_normal, 200.f);
+    YawRotation yaw = YawRotation::fromQuat(ctx.get<Rotation>(e));
 
+    auto writeSample = [&](CountT idx, Entity hit_entity, float hit_t) {
         if (hit_entity == Entity::none()) {
             lidar.samples[idx] = {
                 .depth = 0.f,
@@ -470,6 +847,31 @@ inline void lidarSystem(Engine &ctx,
         }
     };
 
+    auto traceRay = [&](int32_t idx) {
+#ifdef MADRONA_GPU_MODE
+        // One ray per thread, so compute the direction rather than reading
+        // the host side table (src/lidar_dirs.hpp)
+        float theta = 2.f * math::pi * (
+            float(idx) / float(consts::numLidarSamples)) + math::pi / 2.f;
+        Vector3 ray_dir = yaw.rotate(trig::cos(theta), trig::sin(theta));
+#else
+        Vector3 ray_dir = yaw.lidarDir<consts::numLidarSamples>(idx);
+#endif
+
+        float hit_t;
+        Vector3 hit_normal;
+        Entity hit_entity;
+        if (use_raycast_scene) {
+            hit_entity = traceRaycastScene(raycast_scene,
+                pos + 0.5f * math::up, ray_dir, &hit_t, 200.f);
+        } else {
+            hit_entity = bvh.traceRay(pos + 0.5f * math::up, ray_dir,
+                                      &hit_t, &hit_normal, 200.f);
+        }
+
+        writeSample(idx, hit_entity, hit_t);
+    };
+
 
     // MADRONA_GPU_MODE guards GPU specific logic
 #ifdef MADRONA_GPU_MODE
@@ -481,12 +883,158 @@ inline void lidarSystem(Engine &ctx,
         traceRay(idx);
     }
 #else
-    for (CountT i = 0; i < consts::numLidarSamples; i++) {
-        traceRay(i);
+    if (use_raycast_scene) {
+        // Trace simd::floatLanes rays at a time, walking each tree of the
+        // scene once per packet, with 2D tests under planarLidar
+        // (src/raycast_simd.hpp). Lanes past the last sample repeat it and
+        // are dropped.
+        constexpr CountT num_packets =
+            (consts::numLidarSamples + simd::floatLanes - 1) /
+            simd::floatLanes;
+
+        for (CountT packet_idx = 0; packet_idx < num_packets; packet_idx++) {
+            CountT base_idx = packet_idx * simd::floatLanes;
+
+            float ray_dx[simd::floatLanes];
+            float ray_dy[simd::floatLanes];
+            float ray_dz[simd::floatLanes];
+            for (CountT i = 0; i < simd::floatLanes; i++) {
+                CountT idx = std::min(base_idx + i,
+                                      consts::numLidarSamples - 1);
+                Vector3 ray_dir = yaw.lidarDir<consts::numLidarSamples>(idx);
+
+                ray_dx[i] = ray_dir.x;
+                ray_dy[i] = ray_dir.y;
+                ray_dz[i] = ray_dir.z;
+            }
+
+            Entity hit_entities[simd::floatLanes];
+            float hit_ts[simd::floatLanes];
+            if (ctx.data().planarLidar) {
+                traceRaycastScenePlanar(raycast_scene, pos + 0.5f * math::up,
+                    ray_dx, ray_dy, 200.f, hit_entities, hit_ts);
+            } else {
+                traceRaycastScenePacket(raycast_scene, pos + 0.5f * math::up,
+                    ray_dx, ray_dy, ray_dz, 200.f, hit_entities, hit_ts);
+            }
+
+            for (CountT i = 0; i < simd::floatLanes &&
+                    base_idx + i < consts::numLidarSamples; i++) {
+                writeSample(base_idx + i, hit_entities[i], hit_ts[i]);
+            }
+        }
+    } else {
+        for (CountT i = 0; i < consts::numLidarSamples; i++) {
+            traceRay(i);
+        }
     }
 #endif
 }
 
+template <typename T>
+static inline void toFloat16(const T &obs, Float16Observation<T> &out)
+{
+    const float *values = reinterpret_cast<const float *>(&obs);
+    for (CountT i = 0; i < Float16Observation<T>::numValues; i++) {
+        out.v[i] = floatToHalf(values[i]);
+    }
+}
+
+// Fills the fp16 observation exports from the output of
+// collectObservationsSystem. Only part of the task graphs when
+// Sim::Config::compactObservations is set.
+inline void compactObservationsSystem(Engine &,
+                                      const SelfObservation &self_obs,
+                                      const PartnerObservations &partner_obs,
+                                      const RoomEntityObservations &room_obs,
+                                      const DoorObservation &door_obs,
+                                      SelfObservationF16 &self_obs_f16,
+                                      PartnerObservationsF16 &partner_obs_f16,
+                                      RoomEntityObservationsF16 &room_obs_f16,
+                                      DoorObservationF16 &door_obs_f16)
+{
+    toFloat16(self_obs, self_obs_f16);
+    toFloat16(partner_obs, partner_obs_f16);
+    toFloat16(room_obs, room_obs_f16);
+    toFloat16(door_obs, door_obs_f16);
+}
+
+// Quantizes lidar into LidarU8
+inline void compactLidarSystem(Engine &,
+                               const Lidar &lidar,
+                               LidarU8 &lidar_u8)
+{
+    for (CountT i = 0; i < consts::numLidarSamples; i++) {
+        const LidarSample &sample = lidar.samples[i];
+        float depth = fminf(fmaxf(sample.depth, 0.f), 1.f);
+
+        lidar_u8.samples[i] = {
+            .depth = uint8_t(depth * 255.f + 0.5f),
+            .type = uint8_t(
+                sample.encodedType * (float)EntityType::NumTypes + 0.5f),
+        };
+    }
+}
+
+template <typename T>
+static inline void copyObservation(const T &obs, float *out)
+{
+    const float *values = reinterpret_cast<const float *>(&obs);
+    for (CountT i = 0; i < CountT(sizeof(T) / sizeof(float)); i++) {
+        out[i] = values[i];
+    }
+}
+
+// Packs the agent's observations into FusedObservation, in the layout
+// documented there. Only part of the task graphs when
+// Sim::Config::fusedObservations is set.
+inline void fuseObservationsSystem(Engine &,
+                                   AgentID agent_id,
+                                   const SelfObservation &self_obs,
+                                   const PartnerObservations &partner_obs,
+                                   const RoomEntityObservations &room_obs,
+                                   const DoorObservation &door_obs,
+                                   StepsRemaining steps_remaining,
+                                   FusedObservation &fused)
+{
+    copyObservation(self_obs, fused.v + FusedObservation::selfOffset);
+    copyObservation(partner_obs, fused.v + FusedObservation::partnerOffset);
+    copyObservation(room_obs, fused.v + FusedObservation::roomEntityOffset);
+    copyObservation(door_obs, fused.v + FusedObservation::doorOffset);
+
+    fused.v[FusedObservation::stepsRemainingOffset] =
+        (float)steps_remaining.t / (float)consts::episodeLen;
+
+    fused.v[FusedObservation::agentIDOffset] = consts::numAgents > 1 ?
+        (float)agent_id.idx / (float)(consts::numAgents - 1) : 0.f;
+}
+
+// Copies lidar into FusedObservation
+inline void fuseLidarSystem(Engine &,
+                            const Lidar &lidar,
+                            FusedObservation &fused)
+{
+    copyObservation(lidar, fused.v + FusedObservation::lidarOffset);
+}
+
+// Writes FusedObservation into the agent's ObservationFrames. After a step
+// (advance) the frame goes into the slot following the head, so stacking
+// costs one frame copy. When observations were only recomputed it replaces
+// the newest frame.
+template <bool advance>
+inline void stackObservationFrameSystem(Engine &,
+                                        const FusedObservation &fused,
+                                        ObservationFrames &frames,
+                                        ObservationFrameHead &head)
+{
+    if constexpr (advance) {
+        head.idx = head.idx + 1 == consts::numStackedFrames ?
+            0 : head.idx + 1;
+    }
+
+    copyObservation(fused, frames.frames[head.idx]);
+}
+
 // Computes reward for each agent and keeps track of the max distance achieved
 // so far through the challenge. Continuous reward is provided for any new
 // distance achieved.
@@ -553,6 +1101,127 @@ inline void stepTrackerSystem(Engine &,
 
 }
 
+// With Sim::Config::unfusedRewards the Step graph runs stepTrackerSystem on
+// Done as its own node, as before rewardDoneSystem existed. This publishes
+// that Done as the step's StepRepeat::stepDone, which resetSystem reads.
+inline void unfusedStepDoneSystem(Engine &ctx, StepRepeat &step_repeat)
+{
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        step_repeat.stepDone[i] = ctx.get<Done>(ctx.data().agents[i]).v;
+    }
+    step_repeat.stepIdx = 0;
+}
+
+// Runs rewardSystem, bonusRewardSystem and stepTrackerSystem for all agents
+// of a world as one task graph node. Together they are only a few flops per
+// agent, so as separate nodes the per-node overhead dominated on the CPU
+// backend with many worlds. Every agent's reward and Progress is computed
+// before any bonus, since the bonus reads the partners' updated Progress.
+//
+// Within one Manager::step(num_steps) call, every step after the first adds
+// its reward to the previous ones, and an agent that was done keeps its
+// reward and Done for the remaining steps. The world itself keeps stepping,
+// through the automatic reset if there is one, exactly as num_steps single
+// step calls would: stepTrackerSystem and resetSystem work on the per step
+// StepRepeat::stepDone rather than the latched Done. repeat is set for the
+// RepeatStep graph, which runs all but the last of these steps.
+template <bool repeat>
+inline void rewardDoneSystem(Engine &ctx, StepRepeat &step_repeat)
+{
+    bool accumulate = step_repeat.stepIdx > 0;
+
+    float prev_rewards[consts::numAgents];
+    int32_t prev_dones[consts::numAgents];
+    if (accumulate) {
+        for (CountT i = 0; i < consts::numAgents; i++) {
+            Entity agent = ctx.data().agents[i];
+            prev_rewards[i] = ctx.get<Reward>(agent).v;
+            prev_dones[i] = ctx.get<Done>(agent).v;
+        }
+    }
+
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        Entity agent = ctx.data().agents[i];
+
+        rewardSystem(ctx, ctx.get<Position>(agent),
+                     ctx.get<Progress>(agent), ctx.get<Reward>(agent));
+    }
+
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        Entity agent = ctx.data().agents[i];
+
+        bonusRewardSystem(ctx, ctx.get<OtherAgents>(agent),
+                          ctx.get<Progress>(agent), ctx.get<Reward>(agent));
+
+        Done step_done { step_repeat.stepDone[i] };
+        stepTrackerSystem(ctx, ctx.get<StepsRemaining>(agent), step_done);
+        step_repeat.stepDone[i] = step_done.v;
+        ctx.get<Done>(agent) = step_done;
+    }
+
+    if (accumulate) {
+        for (CountT i = 0; i < consts::numAgents; i++) {
+            Entity agent = ctx.data().agents[i];
+            Reward &reward = ctx.get<Reward>(agent);
+            Done &done = ctx.get<Done>(agent);
+
+            if (prev_dones[i] != 0) {
+                reward.v = prev_rewards[i];
+                done.v = 1;
+            } else {
+                reward.v += prev_rewards[i];
+            }
+        }
+    }
+
+    if constexpr (repeat) {
+        step_repeat.stepIdx += 1;
+    } else {
+        step_repeat.stepIdx = 0;
+    }
+}
+
+static inline int64_t timestampNs()
+{
+#ifdef MADRONA_GPU_MODE
+    uint64_t ns;
+    asm volatile("mov.u64 %0, %%globaltimer;" : "=l"(ns));
+    return (int64_t)ns;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Marks the start of a timed task graph. Only world 0 records, see
+// TaskTimings.
+template <bool count_step>
+inline void startTaskTimingSystem(Engine &ctx, TaskTimings &timings)
+{
+    if (ctx.worldID().idx != 0) {
+        return;
+    }
+
+    if constexpr (count_step) {
+        timings.numSteps += 1;
+    }
+
+    timings.lastTimestamp = timestampNs();
+}
+
+// Adds the time since the end of the previous phase to phase
+template <TaskPhase phase>
+inline void endTaskPhaseSystem(Engine &ctx, TaskTimings &timings)
+{
+    if (ctx.worldID().idx != 0) {
+        return;
+    }
+
+    int64_t now = timestampNs();
+    timings.phaseNs[(uint32_t)phase] += now - timings.lastTimestamp;
+    timings.lastTimestamp = now;
+}
+
 // Helper function for sorting nodes in the taskgraph.
 // Sorting is only supported / required on the GPU backend,
 // since the CPU backend currently keeps separate tables for each world.
@@ -573,10 +1242,234 @@ TaskGraph::NodeID queueSortByWorld(TaskGraph::Builder &builder,
 }
 #endif
 
-// Build the task graph
-void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
+static TaskGraph::NodeID queueLidarSystem(TaskGraph::Builder &builder,
+                                          Span<const TaskGraph::NodeID> deps)
 {
-    TaskGraphBuilder &builder = taskgraph_mgr.init(TaskGraphID::Step);
+#ifdef MADRONA_GPU_MODE
+    // Note the use of CustomParallelForNode to create a taskgraph node
+    // that launches a warp of threads (32) for each invocation (1).
+    // The 32, 1 parameters could be changed to 32, 32 to create a system
+    // that cooperatively processes 32 entities within a warp.
+    return builder.addToGraph<CustomParallelForNode<Engine,
+        lidarSystem, 32, 1,
+#else
+    return builder.addToGraph<ParallelForNode<Engine,
+        lidarSystem,
+#endif
+            Entity,
+            Lidar
+        >>(deps);
+}
+
+// Brings the physics BVH of every world up to date with the current body
+// transforms for lidar (bvhLeafSystem, bvhUpdateSystem)
+static TaskGraph::NodeID queueBVHUpdateTasks(
+    TaskGraph::Builder &builder,
+    Span<const TaskGraph::NodeID> deps)
+{
+    auto update_leaves = builder.addToGraph<ParallelForNode<Engine,
+        bvhLeafSystem,
+            broadphase::LeafID,
+            Position,
+            Rotation,
+            Scale,
+            ObjectID,
+            Velocity
+        >>(deps);
+
+    return builder.addToGraph<ParallelForNode<Engine,
+        bvhUpdateSystem,
+            broadphase::BVH
+        >>({update_leaves});
+}
+
+// Adds a node closing phase once node is done, if Sim::Config::taskTimings
+// is set. Returns the node the next phase should depend on.
+template <TaskPhase phase>
+static TaskGraph::NodeID queueTaskPhaseEnd(TaskGraph::Builder &builder,
+                                           const Sim::Config &cfg,
+                                           TaskGraph::NodeID node)
+{
+    if (!cfg.taskTimings) {
+        return node;
+    }
+
+    return builder.addToGraph<ParallelForNode<Engine,
+        endTaskPhaseSystem<phase>,
+            TaskTimings
+        >>({node});
+}
+
+// Adds the node starting the timing of a task graph, if
+// Sim::Config::taskTimings is set. Returns the dependencies of the graph's
+// first node.
+template <bool count_step>
+static Span<const TaskGraph::NodeID> queueTaskTimingStart(
+    TaskGraph::Builder &builder,
+    const Sim::Config &cfg,
+    TaskGraph::NodeID &start)
+{
+    if (!cfg.taskTimings) {
+        return Span<const TaskGraph::NodeID>(nullptr, 0);
+    }
+
+    start = builder.addToGraph<ParallelForNode<Engine,
+        startTaskTimingSystem<count_step>,
+            TaskTimings
+        >>({});
+
+    return Span<const TaskGraph::NodeID>(&start, 1);
+}
+
+// Adds the system pushing FusedObservation into ObservationFrames once
+// fused, the last node writing it, is done. advance_frames is set when
+// the graph stepped the simulation.
+template <bool advance_frames>
+static TaskGraph::NodeID queueFrameStackTasks(TaskGraph::Builder &builder,
+                                              const Sim::Config &cfg,
+                                              TaskGraph::NodeID fused)
+{
+    if (!cfg.fusedObservations || !cfg.frameStacking) {
+        return fused;
+    }
+
+    return builder.addToGraph<ParallelForNode<Engine,
+        stackObservationFrameSystem<advance_frames>,
+            FusedObservation,
+            ObservationFrames,
+            ObservationFrameHead
+        >>({fused});
+}
+
+// Adds the systems filling the optional observation exports once
+// collect_obs and lidar are done. Returns the last of them, or lidar if
+// none are enabled.
+template <bool advance_frames>
+static TaskGraph::NodeID queueObservationExportTasks(
+    TaskGraph::Builder &builder,
+    const Sim::Config &cfg,
+    TaskGraph::NodeID collect_obs,
+    TaskGraph::NodeID lidar)
+{
+    TaskGraph::NodeID last = lidar;
+
+    if (cfg.compactObservations) {
+        auto compact_obs = builder.addToGraph<ParallelForNode<Engine,
+            compactObservationsSystem,
+                SelfObservation,
+                PartnerObservations,
+                RoomEntityObservations,
+                DoorObservation,
+                SelfObservationF16,
+                PartnerObservationsF16,
+                RoomEntityObservationsF16,
+                DoorObservationF16
+            >>({collect_obs, last});
+
+        last = builder.addToGraph<ParallelForNode<Engine,
+            compactLidarSystem,
+                Lidar,
+                LidarU8
+            >>({compact_obs});
+    }
+
+    if (cfg.fusedObservations) {
+        auto fuse_obs = builder.addToGraph<ParallelForNode<Engine,
+            fuseObservationsSystem,
+                AgentID,
+                SelfObservation,
+                PartnerObservations,
+                RoomEntityObservations,
+                DoorObservation,
+                StepsRemaining,
+                FusedObservation
+            >>({collect_obs, last});
+
+        last = builder.addToGraph<ParallelForNode<Engine,
+            fuseLidarSystem,
+                Lidar,
+                FusedObservation
+            >>({fuse_obs});
+
+        last = queueFrameStackTasks<advance_frames>(builder, cfg, last);
+    }
+
+    return last;
+}
+
+// Builds the BVH from the current state of every world and collects all
+// observations from it. Used by the Reset and Observe task graphs, which
+// refresh observations without stepping physics.
+static void queueObserveTasks(TaskGraph::Builder &builder,
+                              const Sim::Config &cfg,
+                              Span<const TaskGraph::NodeID> deps)
+{
+    auto broadphase_setup_sys = phys::PhysicsSystem::setupBroadphaseTasks(
+        builder, deps);
+
+    if (cfg.useRaycastScene) {
+        broadphase_setup_sys = builder.addToGraph<ParallelForNode<Engine,
+            raycastRefitSystem,
+                RaycastScene
+            >>({broadphase_setup_sys});
+    }
+
+    auto collect_obs = builder.addToGraph<ParallelForNode<Engine,
+        collectObservationsSystem,
+            Position,
+            Rotation,
+            Progress,
+            GrabState,
+            OtherAgents,
+            SelfObservation,
+            PartnerObservations,
+            RoomEntityObservations,
+            DoorObservation
+        >>({broadphase_setup_sys});
+
+    auto lidar = queueLidarSystem(builder, {broadphase_setup_sys});
+
+    // Nothing stepped, so the frame stack only refreshes its newest frame
+    lidar = queueObservationExportTasks<false>(
+        builder, cfg, collect_obs, lidar);
+
+    if (cfg.renderBridge) {
+        RenderingSystem::setupTasks(builder, {broadphase_setup_sys});
+    }
+
+#ifdef MADRONA_GPU_MODE
+    auto sort_agents = queueSortByWorld<Agent>(
+        builder, {lidar, collect_obs});
+    auto sort_phys_objects = queueSortByWorld<PhysicsEntity>(
+        builder, {sort_agents});
+    auto sort_buttons = queueSortByWorld<ButtonEntity>(
+        builder, {sort_phys_objects});
+    auto sort_walls = queueSortByWorld<DoorEntity>(
+        builder, {sort_buttons});
+    (void)sort_walls;
+#else
+    auto clear_tmp = builder.addToGraph<ResetTmpAllocNode>(
+        {lidar, collect_obs});
+    (void)clear_tmp;
+#endif
+}
+
+// Build the task graphs
+// Adds the nodes advancing the simulation by one step, from applying the
+// actions up to resetting finished worlds. repeat is set for the RepeatStep
+// graph, whose reward and done accumulate into the following step's (see
+// StepRepeat). Returns the last node.
+template <bool repeat>
+static TaskGraph::NodeID queueSimulationTasks(TaskGraph::Builder &builder,
+                                              const Sim::Config &cfg)
+{
+    // With cfg.taskTimings, each phase below is closed by a
+    // queueTaskPhaseEnd node that the next phase depends on. Only the Step
+    // graph counts a step, so the phase sums of RepeatStep runs are charged
+    // to the Manager::step call they belong to (see TaskTimings).
+    TaskGraph::NodeID step_timing_start;
+    auto step_deps = queueTaskTimingStart<!repeat>(
+        builder, cfg, step_timing_start);
 
     // Turn policy actions into movement
     auto move_sys = builder.addToGraph<ParallelForNode<Engine,
@@ -585,19 +1478,33 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             Rotation,
             ExternalForce,
             ExternalTorque
-        >>({});
+        >>(step_deps);
 
     // Scripted door behavior
     auto set_door_pos_sys = builder.addToGraph<ParallelForNode<Engine,
         setDoorPositionSystem,
-            Position,
-            OpenState
+            MovingDoors
         >>({move_sys});
 
+    set_door_pos_sys = queueTaskPhaseEnd<TaskPhase::Movement>(
+        builder, cfg, set_door_pos_sys);
+
     // Build BVH for broadphase / raycasting
     auto broadphase_setup_sys = phys::PhysicsSystem::setupBroadphaseTasks(
         builder, {set_door_pos_sys});
 
+    // With RaycastScene, grab traces against the dynamic leaves refit to
+    // the door positions set above
+    if (cfg.useRaycastScene) {
+        broadphase_setup_sys = builder.addToGraph<ParallelForNode<Engine,
+            raycastRefitSystem,
+                RaycastScene
+            >>({broadphase_setup_sys});
+    }
+
+    broadphase_setup_sys = queueTaskPhaseEnd<TaskPhase::Broadphase>(
+        builder, cfg, broadphase_setup_sys);
+
     // Grab action, post BVH build to allow raycasting
     auto grab_sys = builder.addToGraph<ParallelForNode<Engine,
         grabSystem,
@@ -608,6 +1515,8 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             GrabState
         >>({broadphase_setup_sys});
 
+    grab_sys = queueTaskPhaseEnd<TaskPhase::Grab>(builder, cfg, grab_sys);
+
     // Physics collision detection and solver
     auto substep_sys = phys::PhysicsSystem::setupPhysicsStepTasks(builder,
         {grab_sys}, consts::numPhysicsSubsteps);
@@ -622,42 +1531,60 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
     auto phys_done = phys::PhysicsSystem::setupCleanupTasks(
         builder, {agent_zero_vel});
 
+    phys_done = queueTaskPhaseEnd<TaskPhase::Physics>(builder, cfg, phys_done);
+
     // Check buttons
     auto button_sys = builder.addToGraph<ParallelForNode<Engine,
         buttonSystem,
-            Position,
-            ButtonState
+            LevelState
         >>({phys_done});
 
     // Set door to start opening if button conditions are met
     auto door_open_sys = builder.addToGraph<ParallelForNode<Engine,
         doorOpenSystem,
-            OpenState,
-            DoorProperties
+            ButtonPresses
         >>({button_sys});
 
-    // Compute initial reward now that physics has updated the world state
-    auto reward_sys = builder.addToGraph<ParallelForNode<Engine,
-         rewardSystem,
-            Position,
-            Progress,
-            Reward
-        >>({door_open_sys});
-
-    // Assign partner's reward
-    auto bonus_reward_sys = builder.addToGraph<ParallelForNode<Engine,
-         bonusRewardSystem,
-            OtherAgents,
-            Progress,
-            Reward
-        >>({reward_sys});
+    door_open_sys = queueTaskPhaseEnd<TaskPhase::Buttons>(
+        builder, cfg, door_open_sys);
+
+    // Compute reward now that physics has updated the world state, add the
+    // partner bonus and check if the episode is over, once per world
+    TaskGraph::NodeID done_sys;
+    if (!repeat && cfg.unfusedRewards) {
+        // Reference order: one node per system, over every agent
+        auto reward_sys = builder.addToGraph<ParallelForNode<Engine,
+             rewardSystem,
+                Position,
+                Progress,
+                Reward
+            >>({door_open_sys});
+
+        auto bonus_reward_sys = builder.addToGraph<ParallelForNode<Engine,
+             bonusRewardSystem,
+                OtherAgents,
+                Progress,
+                Reward
+            >>({reward_sys});
+
+        auto step_tracker_sys = builder.addToGraph<ParallelForNode<Engine,
+            stepTrackerSystem,
+                StepsRemaining,
+                Done
+            >>({bonus_reward_sys});
+
+        done_sys = builder.addToGraph<ParallelForNode<Engine,
+            unfusedStepDoneSystem,
+                StepRepeat
+            >>({step_tracker_sys});
+    } else {
+        done_sys = builder.addToGraph<ParallelForNode<Engine,
+            rewardDoneSystem<repeat>,
+                StepRepeat
+            >>({door_open_sys});
+    }
 
-    // Check if the episode is over
-    auto done_sys = builder.addToGraph<ParallelForNode<Engine,
-        stepTrackerSystem,
-            StepsRemaining,
-            Done
-        >>({bonus_reward_sys});
+    done_sys = queueTaskPhaseEnd<TaskPhase::Rewards>(builder, cfg, done_sys);
 
     // Conditionally reset the world if the episode is over
     auto reset_sys = builder.addToGraph<ParallelForNode<Engine,
@@ -675,11 +1602,15 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
     (void)recycle_sys;
 #endif
 
-    // This second BVH build is a limitation of the current taskgraph API.
-    // It's only necessary if the world was reset, but we don't have a way
-    // to conditionally queue taskgraph nodes yet.
-    auto post_reset_broadphase = phys::PhysicsSystem::setupBroadphaseTasks(
-        builder, {reset_sys});
+    return queueTaskPhaseEnd<TaskPhase::Reset>(builder, cfg, reset_sys);
+}
+
+void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
+{
+    TaskGraphBuilder &builder = taskgraph_mgr.init(TaskGraphID::Step);
+
+    // Physics, rewards and resets
+    auto reset_done = queueSimulationTasks<false>(builder, cfg);
 
     // Finally, collect observations for the next step.
     auto collect_obs = builder.addToGraph<ParallelForNode<Engine,
@@ -693,31 +1624,40 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             PartnerObservations,
             RoomEntityObservations,
             DoorObservation
-        >>({post_reset_broadphase});
+        >>({reset_done});
+
+    auto obs_done = queueTaskPhaseEnd<TaskPhase::Observations>(
+        builder, cfg, collect_obs);
+
+    // The lidar system. Physics and reset moved the bodies since the
+    // broadphase build, so the ray structure is brought up to date first:
+    // the BVH leaves are refreshed and the tree refit, which rebuilds it
+    // only for the worlds that were regenerated. Unlike the full
+    // setupBroadphaseTasks, this skips the overlap search that only the
+    // physics step needs. RaycastScene is refit instead when lidar uses it.
+    TaskGraph::NodeID ray_structure;
+    if (cfg.useRaycastScene) {
+        ray_structure = builder.addToGraph<ParallelForNode<Engine,
+            raycastRefitSystem,
+                RaycastScene
+            >>({reset_done, obs_done});
+    } else {
+        ray_structure = queueBVHUpdateTasks(builder, {reset_done, obs_done});
+    }
 
-    // The lidar system
-#ifdef MADRONA_GPU_MODE
-    // Note the use of CustomParallelForNode to create a taskgraph node
-    // that launches a warp of threads (32) for each invocation (1).
-    // The 32, 1 parameters could be changed to 32, 32 to create a system
-    // that cooperatively processes 32 entities within a warp.
-    auto lidar = builder.addToGraph<CustomParallelForNode<Engine,
-        lidarSystem, 32, 1,
-#else
-    auto lidar = builder.addToGraph<ParallelForNode<Engine,
-        lidarSystem,
-#endif
-            Entity,
-            Lidar
-        >>({post_reset_broadphase});
+    auto lidar = queueLidarSystem(builder, {ray_structure});
+    lidar = queueObservationExportTasks<true>(
+        builder, cfg, collect_obs, lidar);
+
+    lidar = queueTaskPhaseEnd<TaskPhase::Lidar>(builder, cfg, lidar);
 
     if (cfg.renderBridge) {
-        RenderingSystem::setupTasks(builder, {reset_sys});
+        RenderingSystem::setupTasks(builder, {reset_done});
     }
 
 #ifdef MADRONA_GPU_MODE
-    // Sort entities, this could be conditional on reset like the second
-    // BVH build above.
+    // Sort entities, this could be conditional on reset like the
+    // BVH rebuild above.
     auto sort_agents = queueSortByWorld<Agent>(
         builder, {lidar, collect_obs});
     auto sort_phys_objects = queueSortByWorld<PhysicsEntity>(
@@ -731,6 +1671,56 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
     (void)lidar;
     (void)collect_obs;
 #endif
+
+    // The RepeatStep task graph only advances the simulation, for all but
+    // the last step of Manager::step(num_steps). The skipped observations
+    // would be overwritten by the next step anyway.
+    TaskGraphBuilder &repeat_builder =
+        taskgraph_mgr.init(TaskGraphID::RepeatStep);
+
+    auto repeat_done = queueSimulationTasks<true>(repeat_builder, cfg);
+
+#ifdef MADRONA_GPU_MODE
+    auto repeat_sort_agents = queueSortByWorld<Agent>(
+        repeat_builder, {repeat_done});
+    auto repeat_sort_phys_objects = queueSortByWorld<PhysicsEntity>(
+        repeat_builder, {repeat_sort_agents});
+    auto repeat_sort_buttons = queueSortByWorld<ButtonEntity>(
+        repeat_builder, {repeat_sort_phys_objects});
+    auto repeat_sort_walls = queueSortByWorld<DoorEntity>(
+        repeat_builder, {repeat_sort_buttons});
+    (void)repeat_sort_walls;
+#else
+    (void)repeat_done;
+#endif
+
+    // The Reset task graph regenerates the worlds external code asked to
+    // reset and collects their initial observations, without running
+    // physics, rewards or episode tracking. Manager uses it for the first
+    // observations after initialization as well as for bulk resets.
+    TaskGraphBuilder &reset_builder = taskgraph_mgr.init(TaskGraphID::Reset);
+
+    auto external_reset_sys = reset_builder.addToGraph<ParallelForNode<Engine,
+        externalResetSystem,
+            WorldReset
+        >>({});
+
+    auto reset_clear_tmp =
+        reset_builder.addToGraph<ResetTmpAllocNode>({external_reset_sys});
+
+#ifdef MADRONA_GPU_MODE
+    auto reset_recycle_sys =
+        reset_builder.addToGraph<RecycleEntitiesNode>({reset_clear_tmp});
+    queueObserveTasks(reset_builder, cfg, {reset_recycle_sys});
+#else
+    queueObserveTasks(reset_builder, cfg, {reset_clear_tmp});
+#endif
+
+    // The Observe task graph only recomputes observations from the current
+    // world state, e.g. after external code edited positions.
+    TaskGraphBuilder &observe_builder =
+        taskgraph_mgr.init(TaskGraphID::Observe);
+    queueObserveTasks(observe_builder, cfg, {});
 }
 
 Sim::Sim(Engine &ctx,
@@ -751,6 +1741,17 @@ Sim::Sim(Engine &ctx,
 
     initRandKey = cfg.initRandKey;
     autoReset = cfg.autoReset;
+    useEntityPool = cfg.useEntityPool;
+    levelBank = cfg.levelBank;
+    numBankLevels = cfg.numBankLevels;
+    useRaycastScene = cfg.useRaycastScene;
+    simdObservations = cfg.simdObservations;
+    planarLidar = cfg.useRaycastScene && cfg.planarLidar;
+    bvhButtonQuery = cfg.bvhButtonQuery;
+    frameStacking = cfg.fusedObservations && cfg.frameStacking;
+    rigidBodyObjMgr = cfg.rigidBodyObjMgr;
+    levelPrefetch = cfg.levelPrefetchSlots == nullptr ? nullptr :
+        &cfg.levelPrefetchSlots[ctx.worldID().idx];
 
     enableRender = cfg.renderBridge != nullptr;
 
@@ -760,11 +1761,24 @@ Sim::Sim(Engine &ctx,
 
     curWorldEpisode = 0;
 
+    ctx.singleton<LevelSelect>() = {
+        .requested = -1,
+        .current = -1,
+    };
+
+    ctx.singleton<StepRepeat>() = {};
+
+    ctx.singleton<TaskTimings>() = {};
+
     // Creates agents, walls, etc.
     createPersistentEntities(ctx);
 
-    // Generate initial world state
+    // Generate initial world state. Manager collects the first observations
+    // through the Reset graph without flagging any world, so this is the
+    // level of the first episode.
+    ctx.singleton<WorldReset>().reset = 0;
     initWorld(ctx);
+    clearStepOutputs(ctx);
 }
 
 // This declaration is needed for the GPU backend in order to generate the
@@ -6,6 +6,7 @@
 
 #include "consts.hpp"
 #include "types.hpp"
+#include "raycast.hpp"
 
 namespace madEscape {
 
@@ -15,6 +16,9 @@ class Engine;
 // that can be separately executed
 enum class TaskGraphID : uint32_t {
   Step,
+  Reset,
+  Observe,
+  RepeatStep,
   NumTaskGraphs,
 };
 
@@ -31,6 +35,17 @@ enum class ExportID : uint32_t {
     DoorObservation,
     Lidar,
     StepsRemaining,
+    LevelSelect,
+    SelfObservationF16,
+    PartnerObservationsF16,
+    RoomEntityObservationsF16,
+    DoorObservationF16,
+    LidarU8,
+    FusedObservation,
+    ObservationFrames,
+    ObservationFrameHead,
+    TaskTimings,
+    ButtonPresses,
     NumExports,
 };
 
@@ -59,6 +74,41 @@ enum class SimObject : uint32_t {
 struct Sim : public madrona::WorldBase {
     struct Config {
         bool autoReset;
+        bool useEntityPool;
+        // Optional precomputed levels (src/level_bank.hpp). Must be
+        // accessible by the simulation backend (device memory for CUDA).
+        const LevelLayout *levelBank;
+        uint32_t numBankLevels;
+        // Trace lidar and grab rays against RaycastScene (src/raycast.hpp)
+        // instead of the physics BVH
+        bool useRaycastScene;
+        // Per-world layouts prepared ahead of time on the CPU backend, or
+        // nullptr to always generate levels inline
+        LevelPrefetchSlot *levelPrefetchSlots;
+        // CPU backend: compute polar observations with the SIMD kernel in
+        // src/obs_simd.hpp. Ignored on the GPU backend.
+        bool simdObservations;
+        // CPU backend: trace lidar as horizontal rays through RaycastScene
+        // with 2D tests (traceRaycastScenePlanar in src/raycast_simd.hpp).
+        // Requires useRaycastScene. Ignored on the GPU backend.
+        bool planarLidar;
+        // Check buttons with a physics BVH query per button, as buttonSystem
+        // did before its grid. Reference for the grid in tests.
+        bool bvhButtonQuery;
+        // Also write fp16 copies of the observations and a uint8 copy of
+        // lidar (the *F16 / LidarU8 components in src/types.hpp)
+        bool compactObservations;
+        // Also pack every observation of an agent into FusedObservation
+        bool fusedObservations;
+        // Also keep the last consts::numStackedFrames FusedObservations of
+        // each agent in ObservationFrames. Requires fusedObservations.
+        bool frameStacking;
+        // Run rewardSystem, bonusRewardSystem and stepTrackerSystem as
+        // separate nodes in the Step graph instead of rewardDoneSystem.
+        // Reference for the fused node in tests.
+        bool unfusedRewards;
+        // Add nodes timing the phases of the Step graph into TaskTimings
+        bool taskTimings;
         RandKey initRandKey;
         madrona::phys::ObjectManager *rigidBodyObjMgr;
         const madrona::render::RenderECSBridge *renderBridge;
@@ -74,7 +124,7 @@ struct Sim : public madrona::WorldBase {
                               const Config &cfg);
 
     // Sim::setupTasks is called during initialization to build
-    // the system task graph that will be invoked by the 
+    // the system task graphs that will be invoked by the 
     // Manager class (src/mgr.hpp) for each step.
     static void setupTasks(madrona::TaskGraphManager &mgr,
                            const Config &cfg);
@@ -111,6 +161,36 @@ struct Sim : public madrona::WorldBase {
     // Agent entity references. This entities live across all episodes
     // and are just reset to the start of the level on reset.
     Entity agents[consts::numAgents];
+
+    // Should level entities (walls, doors, cubes, buttons) be taken from
+    // entityPool instead of being created and destroyed every episode?
+    bool useEntityPool;
+    LevelEntityPool entityPool;
+
+    // If non-null, episodes instantiate levels from this bank instead of
+    // sampling a new layout on every reset.
+    const LevelLayout *levelBank;
+    uint32_t numBankLevels;
+
+    // Should lidar and grab use the RaycastScene singleton?
+    bool useRaycastScene;
+    // Needed by RaycastScene for the collision mesh bounds of each object
+    const madrona::phys::ObjectManager *rigidBodyObjMgr;
+
+    // If non-null, this world's slot in the level prefetch buffer
+    LevelPrefetchSlot *levelPrefetch;
+
+    // Use the SIMD observation kernel (CPU backend only)?
+    bool simdObservations;
+
+    // Use the 2D lidar caster (CPU backend only)?
+    bool planarLidar;
+
+    // Query the BVH per button instead of the button grid?
+    bool bvhButtonQuery;
+
+    // Are ObservationFrames written (and cleared on reset)?
+    bool frameStacking;
 };
 
 class Engine : public ::madrona::CustomContext<Engine, Sim> {
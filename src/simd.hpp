@@ -0,0 +1,306 @@
+#pragma once
+
+// Minimal 8-wide float vector used by the CPU observation kernels
+// (src/obs_simd.hpp). Backed by one AVX register, two SSE registers, or a
+// plain array that the compiler is free to auto-vectorize, depending on what
+// the target supports. x86-64 builds get SSE by default; configure with
+// -DMADESCAPE_AVX2=ON to compile the AVX backend in. Not used by the GPU
+// backend.
+
+#if defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#define MADESCAPE_SIMD_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MADESCAPE_SIMD_SSE 1
+#endif
+
+#include "fast_math.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+namespace madEscape::simd {
+
+inline constexpr int32_t floatLanes = 8;
+
+#if defined(MADESCAPE_SIMD_AVX)
+
+struct Float8 {
+    __m256 v;
+};
+
+inline Float8 load(const float *p) { return { _mm256_loadu_ps(p) }; }
+inline void store(float *p, Float8 a) { _mm256_storeu_ps(p, a.v); }
+inline Float8 set1(float s) { return { _mm256_set1_ps(s) }; }
+
+inline Float8 operator+(Float8 a, Float8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Float8 operator-(Float8 a, Float8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Float8 operator*(Float8 a, Float8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Float8 operator/(Float8 a, Float8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+
+inline Float8 sqrt(Float8 a) { return { _mm256_sqrt_ps(a.v) }; }
+inline Float8 min(Float8 a, Float8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Float8 max(Float8 a, Float8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+
+inline Float8 abs(Float8 a)
+{
+    return { _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v) };
+}
+
+// Lane-wise mask of a < b / a > b / a <= b, consumed by select
+inline Float8 lessThan(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) };
+}
+
+inline Float8 greaterThan(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) };
+}
+
+inline Float8 lessEqual(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) };
+}
+
+// Lane-wise AND of two masks
+inline Float8 operator&(Float8 a, Float8 b) { return { _mm256_and_ps(a.v, b.v) }; }
+
+// True if any lane of the mask is set
+inline bool any(Float8 mask) { return _mm256_movemask_ps(mask.v) != 0; }
+
+// mask ? a : b
+inline Float8 select(Float8 mask, Float8 a, Float8 b)
+{
+    return { _mm256_blendv_ps(b.v, a.v, mask.v) };
+}
+
+#elif defined(MADESCAPE_SIMD_SSE)
+
+struct Float8 {
+    __m128 lo;
+    __m128 hi;
+};
+
+inline Float8 load(const float *p)
+{
+    return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) };
+}
+
+inline void store(float *p, Float8 a)
+{
+    _mm_storeu_ps(p, a.lo);
+    _mm_storeu_ps(p + 4, a.hi);
+}
+
+inline Float8 set1(float s) { return { _mm_set1_ps(s), _mm_set1_ps(s) }; }
+
+inline Float8 operator+(Float8 a, Float8 b)
+{
+    return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) };
+}
+
+inline Float8 operator-(Float8 a, Float8 b)
+{
+    return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) };
+}
+
+inline Float8 operator*(Float8 a, Float8 b)
+{
+    return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) };
+}
+
+inline Float8 operator/(Float8 a, Float8 b)
+{
+    return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) };
+}
+
+inline Float8 sqrt(Float8 a)
+{
+    return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) };
+}
+
+inline Float8 min(Float8 a, Float8 b)
+{
+    return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) };
+}
+
+inline Float8 max(Float8 a, Float8 b)
+{
+    return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) };
+}
+
+inline Float8 abs(Float8 a)
+{
+    __m128 sign = _mm_set1_ps(-0.f);
+    return { _mm_andnot_ps(sign, a.lo), _mm_andnot_ps(sign, a.hi) };
+}
+
+inline Float8 lessThan(Float8 a, Float8 b)
+{
+    return { _mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi) };
+}
+
+inline Float8 greaterThan(Float8 a, Float8 b)
+{
+    return { _mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi) };
+}
+
+inline Float8 lessEqual(Float8 a, Float8 b)
+{
+    return { _mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi) };
+}
+
+inline Float8 operator&(Float8 a, Float8 b)
+{
+    return { _mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi) };
+}
+
+inline bool any(Float8 mask)
+{
+    return (_mm_movemask_ps(mask.lo) | _mm_movemask_ps(mask.hi)) != 0;
+}
+
+// SSE2 has no blend instruction
+inline Float8 select(Float8 mask, Float8 a, Float8 b)
+{
+    return {
+        _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo)),
+        _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi)),
+    };
+}
+
+#else
+
+struct Float8 {
+    float v[floatLanes];
+};
+
+#define MADESCAPE_SIMD_LANEWISE(expr) \
+    Float8 r;                         \
+    for (int32_t i = 0; i < floatLanes; i++) { r.v[i] = (expr); } \
+    return r
+
+inline Float8 load(const float *p) { MADESCAPE_SIMD_LANEWISE(p[i]); }
+
+inline void store(float *p, Float8 a)
+{
+    for (int32_t i = 0; i < floatLanes; i++) {
+        p[i] = a.v[i];
+    }
+}
+
+inline Float8 set1(float s) { MADESCAPE_SIMD_LANEWISE(s); }
+
+inline Float8 operator+(Float8 a, Float8 b) { MADESCAPE_SIMD_LANEWISE(a.v[i] + b.v[i]); }
+inline Float8 operator-(Float8 a, Float8 b) { MADESCAPE_SIMD_LANEWISE(a.v[i] - b.v[i]); }
+inline Float8 operator*(Float8 a, Float8 b) { MADESCAPE_SIMD_LANEWISE(a.v[i] * b.v[i]); }
+inline Float8 operator/(Float8 a, Float8 b) { MADESCAPE_SIMD_LANEWISE(a.v[i] / b.v[i]); }
+
+inline Float8 sqrt(Float8 a) { MADESCAPE_SIMD_LANEWISE(sqrtf(a.v[i])); }
+inline Float8 min(Float8 a, Float8 b) { MADESCAPE_SIMD_LANEWISE(fminf(a.v[i], b.v[i])); }
+inline Float8 max(Float8 a, Float8 b) { MADESCAPE_SIMD_LANEWISE(fmaxf(a.v[i], b.v[i])); }
+inline Float8 abs(Float8 a) { MADESCAPE_SIMD_LANEWISE(fabsf(a.v[i])); }
+
+// Masks are 1.f / 0.f in the scalar fallback
+inline Float8 lessThan(Float8 a, Float8 b)
+{
+    MADESCAPE_SIMD_LANEWISE(a.v[i] < b.v[i] ? 1.f : 0.f);
+}
+
+inline Float8 greaterThan(Float8 a, Float8 b)
+{
+    MADESCAPE_SIMD_LANEWISE(a.v[i] > b.v[i] ? 1.f : 0.f);
+}
+
+inline Float8 lessEqual(Float8 a, Float8 b)
+{
+    MADESCAPE_SIMD_LANEWISE(a.v[i] <= b.v[i] ? 1.f : 0.f);
+}
+
+inline Float8 operator&(Float8 a, Float8 b)
+{
+    MADESCAPE_SIMD_LANEWISE(a.v[i] != 0.f && b.v[i] != 0.f ? 1.f : 0.f);
+}
+
+inline bool any(Float8 mask)
+{
+    for (int32_t i = 0; i < floatLanes; i++) {
+        if (mask.v[i] != 0.f) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+inline Float8 select(Float8 mask, Float8 a, Float8 b)
+{
+    MADESCAPE_SIMD_LANEWISE(mask.v[i] != 0.f ? a.v[i] : b.v[i]);
+}
+
+#undef MADESCAPE_SIMD_LANEWISE
+
+#endif
+
+// atan(x) for x in [0, 1], same polynomial as fastmath::atan2
+// (src/fast_math.hpp). Max error in float is ~1.1e-7 rad.
+inline Float8 atanUnit(Float8 x)
+{
+    using namespace fastmath::detail;
+
+    Float8 x2 = x * x;
+    Float8 p = set1(atanCoeffs[numAtanCoeffs - 1]);
+    for (int32_t i = numAtanCoeffs - 2; i >= 0; i--) {
+        p = p * x2 + set1(atanCoeffs[i]);
+    }
+
+    return p * x;
+}
+
+// Lane-wise polynomial atan2f(y, x). Max error vs libm is ~3e-7 rad.
+// fastAtan2(0, 0) is 0 like libm, but the sign of zero results is not
+// preserved.
+inline Float8 fastAtan2(Float8 y, Float8 x)
+{
+    constexpr float pi = fastmath::pi;
+
+    Float8 zero = set1(0.f);
+    Float8 abs_y = abs(y);
+    Float8 abs_x = abs(x);
+
+    Float8 num = min(abs_y, abs_x);
+    Float8 denom = max(abs_y, abs_x);
+    Float8 ratio = select(greaterThan(denom, zero), num / denom, zero);
+
+    Float8 theta = atanUnit(ratio);
+    theta = select(greaterThan(abs_y, abs_x), set1(pi / 2.f) - theta, theta);
+    theta = select(lessThan(x, zero), set1(pi) - theta, theta);
+    theta = select(lessThan(y, zero), zero - theta, theta);
+
+    return theta;
+}
+
+// Lane-wise atan2, selected by MADESCAPE_FAST_TRIG like trig::atan2
+// (src/fast_math.hpp): fastAtan2 with it, libm's atan2f per lane without.
+inline Float8 atan2(Float8 y, Float8 x)
+{
+#if MADESCAPE_FAST_TRIG
+    return fastAtan2(y, x);
+#else
+    alignas(32) float ys[floatLanes];
+    alignas(32) float xs[floatLanes];
+    store(ys, y);
+    store(xs, x);
+
+    alignas(32) float out[floatLanes];
+    for (int32_t i = 0; i < floatLanes; i++) {
+        out[i] = atan2f(ys[i], xs[i]);
+    }
+
+    return load(out);
+#endif
+}
+
+}
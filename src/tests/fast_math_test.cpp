@@ -0,0 +1,134 @@
+#include "test_util.hpp"
+#include "../fast_math.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace madEscape;
+
+// Sweeps the polynomial trig functions of src/fast_math.hpp over the input
+// ranges the sim uses and checks their max absolute and relative error
+// against libm's sinf / cosf / atan2f. Relative error is only checked where
+// |libm| >= minRelMagnitude, it is meaningless around the zeros.
+
+static constexpr float minRelMagnitude = 0.01f;
+
+struct ErrorStats {
+    float maxAbs = 0.f;
+    float maxRel = 0.f;
+    float worstInput = 0.f;
+
+    void add(float approx, float ref, float input)
+    {
+        float abs_err = fabsf(approx - ref);
+        if (abs_err > maxAbs) {
+            maxAbs = abs_err;
+            worstInput = input;
+        }
+
+        if (fabsf(ref) >= minRelMagnitude) {
+            maxRel = std::max(maxRel, abs_err / fabsf(ref));
+        }
+    }
+};
+
+static void checkStats(const char *name, const ErrorStats &stats,
+                       float max_abs, float max_rel)
+{
+    printf("%-24s max abs %.3g (at %.9g), max rel %.3g\n",
+           name, stats.maxAbs, stats.worstInput, stats.maxRel);
+
+    TEST_CHECK(stats.maxAbs <= max_abs, "%s: abs error %.3g > %.3g",
+               name, stats.maxAbs, max_abs);
+    TEST_CHECK(stats.maxRel <= max_rel, "%s: rel error %.3g > %.3g",
+               name, stats.maxRel, max_rel);
+}
+
+// Agent and lidar angles: |x| <= 4pi
+static void testSinCos()
+{
+    constexpr float range = 4.f * fastmath::pi;
+    constexpr int64_t num_samples = 20000000;
+
+    ErrorStats sin_stats, cos_stats;
+    for (int64_t i = 0; i <= num_samples; i++) {
+        float x = -range + 2.f * range * (float)i / (float)num_samples;
+        sin_stats.add(fastmath::sin(x), sinf(x), x);
+        cos_stats.add(fastmath::cos(x), cosf(x), x);
+    }
+
+    checkStats("sin |x| <= 4pi", sin_stats, 3e-7f, 3e-5f);
+    checkStats("cos |x| <= 4pi", cos_stats, 3e-7f, 3e-5f);
+}
+
+// Accumulated rotations can go further, accuracy degrades with |x|
+static void testSinCosLarge()
+{
+    constexpr float range = 1000.f;
+    constexpr int64_t num_samples = 20000000;
+
+    ErrorStats sin_stats, cos_stats;
+    for (int64_t i = 0; i <= num_samples; i++) {
+        float x = -range + 2.f * range * (float)i / (float)num_samples;
+        sin_stats.add(fastmath::sin(x), sinf(x), x);
+        cos_stats.add(fastmath::cos(x), cosf(x), x);
+    }
+
+    checkStats("sin |x| <= 1000", sin_stats, 5e-5f, 5e-3f);
+    checkStats("cos |x| <= 1000", cos_stats, 5e-5f, 5e-3f);
+}
+
+// Observation offsets: any direction, lengths from 1mm up to 1km
+static void testAtan2()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> angle_dist(
+        -fastmath::pi, fastmath::pi);
+    std::uniform_real_distribution<float> log_len_dist(-3.f, 3.f);
+
+    ErrorStats stats;
+    auto check = [&](float y, float x) {
+        stats.add(fastmath::atan2(y, x), atan2f(y, x), atan2f(y, x));
+    };
+
+    constexpr int64_t num_samples = 20000000;
+    for (int64_t i = 0; i < num_samples; i++) {
+        float angle = angle_dist(rng);
+        float len = powf(10.f, log_len_dist(rng));
+        check(len * sinf(angle), len * cosf(angle));
+    }
+
+    // Axes, diagonals and tiny values
+    const float special[] = { 0.f, -0.f, 1e-30f, -1e-30f, 1.f, -1.f, 80.f };
+    for (float y : special) {
+        for (float x : special) {
+            // Zero y is checked below, signed zeros differ from libm
+            if (y == 0.f) {
+                continue;
+            }
+            check(y, x);
+        }
+    }
+
+    // The 3.1e-7 documented vs double, plus up to an ulp of libm's own
+    // rounding near pi
+    checkStats("atan2", stats, 5e-7f, 1e-6f);
+
+    // Documented differences: signed zeros are treated as +0
+    TEST_CHECK(fastmath::atan2(0.f, 0.f) == 0.f, "atan2(0, 0) = %g",
+               fastmath::atan2(0.f, 0.f));
+    TEST_CHECK(fastmath::atan2(-0.f, 1.f) == 0.f, "atan2(-0, 1) = %g",
+               fastmath::atan2(-0.f, 1.f));
+    TEST_CHECK(fastmath::atan2(-0.f, -1.f) == fastmath::pi,
+               "atan2(-0, -1) = %g", fastmath::atan2(-0.f, -1.f));
+}
+
+int main()
+{
+    testSinCos();
+    testSinCosLarge();
+    testAtan2();
+
+    return test::testExitCode("fast_math_test");
+}
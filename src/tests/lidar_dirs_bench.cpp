@@ -0,0 +1,115 @@
+#include "../consts.hpp"
+#include "../lidar_dirs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+using namespace madEscape;
+
+// Microbenchmark of the lidar ray direction setup of one agent
+// (consts::numLidarSamples rays): the YawRotation table path of lidarSystem
+// against rotating fwd / right by the full quaternion with a cos / sin per
+// sample, which lidarSystem did before. Prints ns per agent for both and the
+// largest difference between the directions.
+
+static constexpr CountT numSamples = consts::numLidarSamples;
+
+struct RayDirs {
+    float x[numSamples];
+    float y[numSamples];
+    float z[numSamples];
+};
+
+static void tableDirs(Quat rot, RayDirs &out)
+{
+    YawRotation yaw = YawRotation::fromQuat(rot);
+
+    for (CountT i = 0; i < numSamples; i++) {
+        Vector3 dir = yaw.lidarDir<numSamples>(i);
+        out.x[i] = dir.x;
+        out.y[i] = dir.y;
+        out.z[i] = dir.z;
+    }
+}
+
+static void quatDirs(Quat rot, RayDirs &out)
+{
+    Vector3 agent_fwd = rot.rotateVec(math::fwd);
+    Vector3 right = rot.rotateVec(math::right);
+
+    for (CountT i = 0; i < numSamples; i++) {
+        float theta = 2.f * math::pi * (
+            float(i) / float(numSamples)) + math::pi / 2.f;
+        float x = trig::cos(theta);
+        float y = trig::sin(theta);
+
+        Vector3 dir = (x * right + y * agent_fwd).normalize();
+        out.x[i] = dir.x;
+        out.y[i] = dir.y;
+        out.z[i] = dir.z;
+    }
+}
+
+template <typename Fn>
+static double nsPerAgent(const std::vector<Quat> &rots, int64_t num_reps,
+                         Fn &&fn)
+{
+    volatile float sink = 0.f;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t rep = 0; rep < num_reps; rep++) {
+        for (Quat rot : rots) {
+            RayDirs dirs;
+            fn(rot, dirs);
+            sink = sink + dirs.x[0] + dirs.y[numSamples - 1];
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end - start).count();
+    return ns / (double)(num_reps * (int64_t)rots.size());
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t num_reps = argc > 1 ? std::stol(argv[1]) : 200;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> yaw_dist(-pi, pi);
+
+    std::vector<Quat> rots(4096);
+    for (Quat &rot : rots) {
+        rot = Quat::angleAxis(yaw_dist(rng), math::up);
+    }
+
+    float max_diff = 0.f;
+    for (Quat rot : rots) {
+        RayDirs table, quat;
+        tableDirs(rot, table);
+        quatDirs(rot, quat);
+
+        for (CountT i = 0; i < numSamples; i++) {
+            max_diff = std::max({ max_diff,
+                fabsf(table.x[i] - quat.x[i]),
+                fabsf(table.y[i] - quat.y[i]),
+                fabsf(table.z[i] - quat.z[i]) });
+        }
+    }
+
+    double table_ns = nsPerAgent(rots, num_reps, tableDirs);
+    double quat_ns = nsPerAgent(rots, num_reps, quatDirs);
+
+    printf("lidar directions per agent (%ld rays): "
+           "table %.1f ns, quaternion %.1f ns, speedup %.2fx, "
+           "max difference %.2e\n",
+           (long)numSamples, table_ns, quat_ns, quat_ns / table_ns,
+           max_diff);
+
+    return 0;
+}
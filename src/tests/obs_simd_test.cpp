@@ -0,0 +1,126 @@
+#include "test_util.hpp"
+#include "../obs_simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace madrona;
+using namespace madrona::math;
+using namespace madEscape;
+
+// Checks polarObservationsSIMD (src/obs_simd.hpp) against the scalar
+// xyToPolar(to_view.rotateVec(d)) of collectObservationsSystem, with libm's
+// atan2f as the reference, over random offsets and agent yaws covering the
+// whole level. Both outputs must stay within 1e-6 in observation units;
+// theta is skipped for offsets under 1cm, where it is ill-conditioned.
+// The kernel only uses simd::fastAtan2 with MADESCAPE_FAST_TRIG, so it is
+// also checked against atan2f on its own.
+
+static constexpr float maxError = 1e-6f;
+// fastmath::atan2 is within 3.1e-7 rad (src/fast_math.hpp), with some
+// slack for the different operation order of the SIMD version
+static constexpr float maxAtan2Error = 5e-7f;
+static constexpr float minThetaDist = 0.01f;
+
+// Observed angles wrap from 1 to -1 behind the agent
+static float thetaError(float a, float b)
+{
+    float err = fabsf(a - b);
+    return std::min(err, fabsf(err - 2.f));
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> yaw_dist(-pi, pi);
+    std::uniform_real_distribution<float> x_dist(
+        -consts::worldWidth, consts::worldWidth);
+    std::uniform_real_distribution<float> y_dist(
+        -consts::worldLength, consts::worldLength);
+    std::uniform_real_distribution<float> z_dist(-3.f, 3.f);
+
+    constexpr int64_t num_batches = 200000;
+
+    float max_r_err = 0.f;
+    float max_theta_err = 0.f;
+
+    for (int64_t batch = 0; batch < num_batches; batch++) {
+        Quat to_view = Quat::angleAxis(yaw_dist(rng), math::up).inv();
+
+        alignas(32) float dx[simd::floatLanes];
+        alignas(32) float dy[simd::floatLanes];
+        alignas(32) float dz[simd::floatLanes];
+        for (int32_t i = 0; i < simd::floatLanes; i++) {
+            dx[i] = x_dist(rng);
+            dy[i] = y_dist(rng);
+            dz[i] = z_dist(rng);
+        }
+
+        // Axis aligned, tiny and zero offsets in the last lanes
+        dx[5] = 0.f;
+        dy[6] = 0.f;
+        if (batch % 16 == 0) {
+            dx[7] = dx[7] * 1e-4f;
+            dy[7] = dy[7] * 1e-4f;
+        } else if (batch % 16 == 1) {
+            dx[7] = 0.f;
+            dy[7] = 0.f;
+        }
+
+        alignas(32) float r[simd::floatLanes];
+        alignas(32) float theta[simd::floatLanes];
+        polarObservationsSIMD(dx, dy, dz, to_view, r, theta);
+
+        for (int32_t i = 0; i < simd::floatLanes; i++) {
+            Vector3 v = to_view.rotateVec({ dx[i], dy[i], dz[i] });
+            float dist = sqrtf(v.x * v.x + v.y * v.y);
+            float ref_r = dist / consts::worldLength;
+            float ref_theta = atan2f(v.x, v.y) / pi;
+
+            float r_err = fabsf(r[i] - ref_r);
+            max_r_err = std::max(max_r_err, r_err);
+            TEST_CHECK(r_err <= maxError,
+                "r %.9g vs %.9g for offset (%g, %g, %g)",
+                r[i], ref_r, dx[i], dy[i], dz[i]);
+
+            if (dist < minThetaDist) {
+                continue;
+            }
+
+            float theta_err = thetaError(theta[i], ref_theta);
+            max_theta_err = std::max(max_theta_err, theta_err);
+            TEST_CHECK(theta_err <= maxError,
+                "theta %.9g vs %.9g for offset (%g, %g, %g)",
+                theta[i], ref_theta, dx[i], dy[i], dz[i]);
+        }
+    }
+
+    float max_atan2_err = 0.f;
+    for (int64_t batch = 0; batch < num_batches; batch++) {
+        alignas(32) float ys[simd::floatLanes];
+        alignas(32) float xs[simd::floatLanes];
+        for (int32_t i = 0; i < simd::floatLanes; i++) {
+            ys[i] = x_dist(rng);
+            xs[i] = y_dist(rng);
+        }
+        xs[6] = 0.f;
+        ys[7] = 0.f;
+
+        alignas(32) float out[simd::floatLanes];
+        simd::store(out, simd::fastAtan2(simd::load(ys), simd::load(xs)));
+
+        for (int32_t i = 0; i < simd::floatLanes; i++) {
+            float err = fabsf(out[i] - atan2f(ys[i], xs[i]));
+            max_atan2_err = std::max(max_atan2_err, err);
+            TEST_CHECK(err <= maxAtan2Error,
+                "fastAtan2(%g, %g) = %.9g vs %.9g",
+                ys[i], xs[i], out[i], atan2f(ys[i], xs[i]));
+        }
+    }
+
+    printf("max error: r %.3g, theta %.3g, fastAtan2 %.3g rad\n",
+           max_r_err, max_theta_err, max_atan2_err);
+
+    return test::testExitCode("obs_simd_test");
+}
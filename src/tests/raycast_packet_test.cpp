@@ -0,0 +1,254 @@
+#include "test_util.hpp"
+#include "../raycast_simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace madrona;
+using namespace madrona::math;
+using namespace madEscape;
+
+// Checks traceRaycastScenePacket and, for horizontal packets,
+// traceRaycastScenePlanar (src/raycast_simd.hpp) against one
+// traceRaycastScene call per lane, over random scenes filled with walls and
+// yawed or tipped over boxes. Every lane must report a hit distance within
+// maxDistError and the same entity, or, where the ray hits two boxes at the
+// same distance, another entity the ray hits at that distance.
+
+static constexpr float maxDistError = 1e-4f;
+static constexpr float sceneExtent = 20.f;
+static constexpr float maxT = 200.f;
+
+static AABB emptyAABB()
+{
+    return AABB {
+        .pMin = Vector3 { INFINITY, INFINITY, INFINITY },
+        .pMax = Vector3 { -INFINITY, -INFINITY, -INFINITY },
+    };
+}
+
+static AABB mergeAABB(const AABB &a, const AABB &b)
+{
+    return AABB {
+        .pMin = Vector3 {
+            fminf(a.pMin.x, b.pMin.x),
+            fminf(a.pMin.y, b.pMin.y),
+            fminf(a.pMin.z, b.pMin.z),
+        },
+        .pMax = Vector3 {
+            fmaxf(a.pMax.x, b.pMax.x),
+            fmaxf(a.pMax.y, b.pMax.y),
+            fmaxf(a.pMax.z, b.pMax.z),
+        },
+    };
+}
+
+template <CountT num_leaves>
+static void buildInternalNodes(AABB *nodes)
+{
+    for (CountT i = num_leaves - 2; i >= 0; i--) {
+        nodes[i] = mergeAABB(nodes[2 * i + 1], nodes[2 * i + 2]);
+    }
+}
+
+static AABB boxBounds(const RaycastScene::Box &box)
+{
+    AABB bounds = emptyAABB();
+    for (int32_t i = 0; i < 8; i++) {
+        Vector3 corner {
+            (i & 1) ? box.halfExtents.x : -box.halfExtents.x,
+            (i & 2) ? box.halfExtents.y : -box.halfExtents.y,
+            (i & 4) ? box.halfExtents.z : -box.halfExtents.z,
+        };
+        Vector3 p = box.center + box.rot.rotateVec(corner);
+        bounds = mergeAABB(bounds, AABB { p, p });
+    }
+
+    return bounds;
+}
+
+// Walls as static leaves; cubes, doors and agents as dynamic boxes, mostly
+// yawed, some tipped over. Entity ids are leaf indices, offset by
+// numStaticLeaves for the dynamic tree.
+static void randomScene(std::mt19937 &rng, RaycastScene &scene)
+{
+    std::uniform_real_distribution<float> pos_dist(-sceneExtent, sceneExtent);
+    std::uniform_real_distribution<float> extent_dist(0.2f, 2.f);
+    std::uniform_real_distribution<float> height_dist(0.f, 2.f);
+    std::uniform_real_distribution<float> angle_dist(-pi, pi);
+    std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+
+    for (CountT i = 0; i < RaycastScene::numStaticLeaves; i++) {
+        AABB leaf = emptyAABB();
+        if (i < RaycastScene::maxStaticBoxes) {
+            Vector3 center { pos_dist(rng), pos_dist(rng), 0.f };
+            Vector3 half { extent_dist(rng), extent_dist(rng),
+                           extent_dist(rng) };
+            if (i % 2 == 0) {
+                half.x *= 8.f;
+            } else {
+                half.y *= 8.f;
+            }
+
+            leaf = AABB { center - half, center + half };
+        }
+
+        scene.staticNodes[RaycastScene::numStaticLeaves - 1 + i] = leaf;
+        scene.staticEntities[i] = Entity { 0, int32_t(i) };
+    }
+    buildInternalNodes<RaycastScene::numStaticLeaves>(scene.staticNodes);
+
+    scene.numDynamic = RaycastScene::maxDynamicBoxes;
+    for (CountT i = 0; i < RaycastScene::numDynamicLeaves; i++) {
+        AABB leaf = emptyAABB();
+        if (i < scene.numDynamic) {
+            Quat rot = Quat::angleAxis(angle_dist(rng), math::up);
+            if (unit_dist(rng) < 0.25f) {
+                Vector3 axis = Vector3 {
+                    unit_dist(rng) - 0.5f,
+                    unit_dist(rng) - 0.5f,
+                    unit_dist(rng) - 0.5f,
+                }.normalize();
+                rot = (Quat::angleAxis(angle_dist(rng), axis) * rot)
+                    .normalize();
+            }
+
+            RaycastScene::Box box {
+                .center = { pos_dist(rng), pos_dist(rng), height_dist(rng) },
+                .rot = rot,
+                .halfExtents = { extent_dist(rng), extent_dist(rng),
+                                 extent_dist(rng) },
+            };
+
+            scene.dynamicBoxes[i] = box;
+            leaf = boxBounds(box);
+        }
+
+        scene.dynamicNodes[RaycastScene::numDynamicLeaves - 1 + i] = leaf;
+        scene.dynamicEntities[i] = Entity {
+            0, int32_t(RaycastScene::numStaticLeaves + i) };
+    }
+    buildInternalNodes<RaycastScene::numDynamicLeaves>(scene.dynamicNodes);
+}
+
+// Distance at which the ray enters entity e's box alone, INFINITY if it
+// doesn't
+static float entityHitT(const RaycastScene &scene, Entity e,
+                        Vector3 ray_o, Vector3 ray_d)
+{
+    if (e.id < RaycastScene::numStaticLeaves) {
+        return raycast::intersectAABB(
+            scene.staticNodes[RaycastScene::numStaticLeaves - 1 + e.id],
+            ray_o, raycast::invDir(ray_d), maxT);
+    }
+
+    const RaycastScene::Box &box =
+        scene.dynamicBoxes[e.id - RaycastScene::numStaticLeaves];
+    Quat to_local = box.rot.inv();
+    AABB local_box { -box.halfExtents, box.halfExtents };
+
+    return raycast::intersectAABB(local_box,
+        to_local.rotateVec(ray_o - box.center),
+        raycast::invDir(to_local.rotateVec(ray_d)), maxT);
+}
+
+static void checkLane(const char *name, const RaycastScene &scene,
+                      Vector3 ray_o, Vector3 ray_d, CountT lane,
+                      Entity ref_entity, float ref_t,
+                      Entity entity, float t)
+{
+    float tolerance = maxDistError * std::max(1.f, ref_t);
+
+    TEST_CHECK(fabsf(t - ref_t) <= tolerance,
+        "%s lane %ld: hit distance %.9g vs %.9g, direction (%g, %g, %g)",
+        name, (long)lane, t, ref_t, ray_d.x, ray_d.y, ray_d.z);
+
+    bool tie = entity != Entity::none() && ref_entity != Entity::none() &&
+        fabsf(entityHitT(scene, entity, ray_o, ray_d) - ref_t) <= tolerance;
+
+    TEST_CHECK(entity == ref_entity || tie,
+        "%s lane %ld: hit entity %d vs %d, direction (%g, %g, %g)",
+        name, (long)lane, entity.id, ref_entity.id,
+        ray_d.x, ray_d.y, ray_d.z);
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos_dist(-sceneExtent, sceneExtent);
+    std::uniform_real_distribution<float> height_dist(0.f, 2.f);
+    std::uniform_real_distribution<float> angle_dist(-pi, pi);
+    std::uniform_real_distribution<float> pitch_dist(-0.5f, 0.5f);
+
+    constexpr int64_t num_scenes = 2000;
+    constexpr int64_t packets_per_scene = 64;
+
+    int64_t num_hits = 0;
+    int64_t num_rays = 0;
+
+    RaycastScene scene;
+    for (int64_t scene_idx = 0; scene_idx < num_scenes; scene_idx++) {
+        randomScene(rng, scene);
+
+        for (int64_t packet_idx = 0; packet_idx < packets_per_scene;
+             packet_idx++) {
+            Vector3 ray_o { pos_dist(rng), pos_dist(rng), height_dist(rng) };
+
+            // Half of the packets are horizontal, like lidar casts. Lane 0
+            // of each packet is axis aligned.
+            bool horizontal = packet_idx % 2 == 0;
+
+            alignas(32) float dx[simd::floatLanes];
+            alignas(32) float dy[simd::floatLanes];
+            alignas(32) float dz[simd::floatLanes];
+            for (CountT i = 0; i < simd::floatLanes; i++) {
+                float yaw = angle_dist(rng);
+                float pitch = horizontal ? 0.f : pitch_dist(rng);
+                dx[i] = cosf(pitch) * cosf(yaw);
+                dy[i] = cosf(pitch) * sinf(yaw);
+                dz[i] = sinf(pitch);
+            }
+            dx[0] = 0.f;
+            dy[0] = 1.f;
+            dz[0] = 0.f;
+
+            Entity hit_entities[simd::floatLanes];
+            float hit_ts[simd::floatLanes];
+            traceRaycastScenePacket(scene, ray_o, dx, dy, dz, maxT,
+                                    hit_entities, hit_ts);
+
+            Entity planar_entities[simd::floatLanes];
+            float planar_ts[simd::floatLanes];
+            if (horizontal) {
+                traceRaycastScenePlanar(scene, ray_o, dx, dy, maxT,
+                                        planar_entities, planar_ts);
+            }
+
+            for (CountT i = 0; i < simd::floatLanes; i++) {
+                Vector3 ray_d { dx[i], dy[i], dz[i] };
+
+                float ref_t;
+                Entity ref_entity = traceRaycastScene(scene, ray_o, ray_d,
+                                                      &ref_t, maxT);
+
+                checkLane("packet", scene, ray_o, ray_d, i,
+                          ref_entity, ref_t, hit_entities[i], hit_ts[i]);
+                if (horizontal) {
+                    checkLane("planar", scene, ray_o, ray_d, i,
+                              ref_entity, ref_t,
+                              planar_entities[i], planar_ts[i]);
+                }
+
+                num_rays++;
+                if (ref_entity != Entity::none()) {
+                    num_hits++;
+                }
+            }
+        }
+    }
+
+    printf("%ld rays, %ld hits\n", (long)num_rays, (long)num_hits);
+
+    return test::testExitCode("raycast_packet_test");
+}
@@ -0,0 +1,393 @@
+#include "sim_test_util.hpp"
+
+#include "../level_bank.hpp"
+#include "../level_gen.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace madrona;
+using namespace madEscape;
+using namespace madEscape::test;
+
+// Runs pairs of managers that only differ in an option documented to not
+// change the simulation, from the same seed with the same scripted actions,
+// and compares their exported observations after every step. Cases that
+// check a task graph against a reference path compare against it within one
+// manager instead.
+
+static constexpr uint32_t numWorlds = 16;
+// Long enough to cover an automatic reset of every world
+static constexpr int64_t numSteps = consts::episodeLen + 50;
+
+// The Step graph traces lidar against a BVH whose leaves it refreshes and
+// refits after physics and reset, rebuilding only regenerated worlds, where
+// it used to run the full broadphase build a second time. The Observe graph
+// still runs that full build, so refreshing observations right after a
+// step must reproduce the step's lidar exactly, in worlds that just reset
+// as well as in the others.
+static void testBVHRefitLidar()
+{
+    Manager::Config cfg = cpuTestConfig(numWorlds);
+    Manager mgr(cfg);
+
+    RandomActions actions(numWorlds, 99);
+
+    const int64_t num_floats = agentFloats<Lidar>(numWorlds);
+    std::vector<float> step_lidar(num_floats);
+
+    for (int64_t i = 0; i < numSteps; i++) {
+        actions.apply(mgr);
+        mgr.step();
+
+        const float *lidar = tensorData<float>(mgr.lidarTensor());
+        std::copy(lidar, lidar + num_floats, step_lidar.begin());
+
+        mgr.refreshObservations();
+
+        compareFloats("bvh refit lidar", step_lidar.data(),
+                      tensorData<float>(mgr.lidarTensor()), num_floats, 0.f);
+    }
+}
+
+// Manager::Config::simdObservations: the SIMD kernel stays within 1e-6 of
+// the scalar polar observations (see src/obs_simd.hpp). Offsets under 1cm,
+// where theta is ill-conditioned, don't occur between bodies that collide.
+static void testSIMDObservations()
+{
+    Manager::Config cfg = cpuTestConfig(numWorlds);
+
+    cfg.simdObservations = true;
+    Manager simd_mgr(cfg);
+
+    cfg.simdObservations = false;
+    Manager scalar_mgr(cfg);
+
+    RandomActions simd_actions(numWorlds, 99);
+    RandomActions scalar_actions(numWorlds, 99);
+
+    for (int64_t i = 0; i < numSteps; i++) {
+        simd_actions.apply(simd_mgr);
+        scalar_actions.apply(scalar_mgr);
+
+        simd_mgr.step();
+        scalar_mgr.step();
+
+        comparePolarObservations("simd observations",
+                                 simd_mgr, scalar_mgr, numWorlds, 2e-6f);
+    }
+}
+
+// Manager::Config::planarLidar: the 2D lidar caster gives the same samples
+// as the 3D packet caster over the same raycast scene, up to rounding in the
+// dynamic boxes' local frame transform. A different hit type would change
+// encodedType by at least 1 / EntityType::NumTypes.
+static void testPlanarLidar()
+{
+    Manager::Config cfg = cpuTestConfig(numWorlds);
+    cfg.useRaycastScene = true;
+
+    cfg.planarLidar = true;
+    Manager planar_mgr(cfg);
+
+    cfg.planarLidar = false;
+    Manager packet_mgr(cfg);
+
+    RandomActions planar_actions(numWorlds, 99);
+    RandomActions packet_actions(numWorlds, 99);
+
+    for (int64_t i = 0; i < numSteps; i++) {
+        planar_actions.apply(planar_mgr);
+        packet_actions.apply(packet_mgr);
+
+        planar_mgr.step();
+        packet_mgr.step();
+
+        compareFloats("planar lidar",
+            tensorData<float>(planar_mgr.lidarTensor()),
+            tensorData<float>(packet_mgr.lidarTensor()),
+            agentFloats<Lidar>(numWorlds), 1e-5f);
+    }
+}
+
+// Manager::step(num_steps) with autoReset: the world state after step(k)
+// matches k calls to step(1) with the same actions held, including across
+// the automatic reset in the middle of a call. Reward is the sum over the
+// k steps and Done is latched, so an agent that finished keeps the reward
+// it had when it did. Grabs are left out since a held grab only triggers
+// on the first step of a call.
+static void testStepRepeat()
+{
+    constexpr int32_t repeat = 3;
+    // The episode ends on a RepeatStep graph run rather than on the last
+    // step of a call
+    static_assert(consts::episodeLen % repeat != 0);
+
+    Manager::Config cfg = cpuTestConfig(numWorlds);
+    Manager repeat_mgr(cfg);
+    Manager single_mgr(cfg);
+
+    RandomActions repeat_actions(numWorlds, 99);
+    RandomActions single_actions(numWorlds, 99);
+
+    const int64_t num_agents = (int64_t)numWorlds * consts::numAgents;
+    std::vector<float> rewards(num_agents);
+    std::vector<int32_t> dones(num_agents);
+
+    for (int64_t i = 0; i < numSteps / repeat; i++) {
+        repeat_actions.applyNoGrab(repeat_mgr);
+        single_actions.applyNoGrab(single_mgr);
+
+        repeat_mgr.step(repeat);
+
+        std::fill(rewards.begin(), rewards.end(), 0.f);
+        std::fill(dones.begin(), dones.end(), 0);
+        for (int32_t j = 0; j < repeat; j++) {
+            single_mgr.step();
+
+            const float *step_rewards =
+                tensorData<float>(single_mgr.rewardTensor());
+            const int32_t *step_dones =
+                tensorData<int32_t>(single_mgr.doneTensor());
+            for (int64_t k = 0; k < num_agents; k++) {
+                if (dones[k] == 0) {
+                    rewards[k] += step_rewards[k];
+                    dones[k] = step_dones[k];
+                }
+            }
+        }
+
+        comparePolarObservations("step repeat", repeat_mgr, single_mgr,
+                                 numWorlds, 0.f);
+
+        compareFloats("step repeat: lidar",
+            tensorData<float>(repeat_mgr.lidarTensor()),
+            tensorData<float>(single_mgr.lidarTensor()),
+            agentFloats<Lidar>(numWorlds), 0.f);
+
+        compareFloats("step repeat: reward",
+            tensorData<float>(repeat_mgr.rewardTensor()),
+            rewards.data(), num_agents, 1e-6f);
+
+        const uint32_t *repeat_steps_remaining =
+            tensorData<uint32_t>(repeat_mgr.stepsRemainingTensor());
+        const uint32_t *single_steps_remaining =
+            tensorData<uint32_t>(single_mgr.stepsRemainingTensor());
+        const int32_t *repeat_dones =
+            tensorData<int32_t>(repeat_mgr.doneTensor());
+        for (int64_t k = 0; k < num_agents; k++) {
+            TEST_CHECK(repeat_dones[k] == dones[k],
+                "step %lld agent %lld: done %d vs %d",
+                (long long)(i * repeat), (long long)k,
+                repeat_dones[k], dones[k]);
+            TEST_CHECK(
+                repeat_steps_remaining[k] == single_steps_remaining[k],
+                "step %lld agent %lld: steps remaining %u vs %u",
+                (long long)(i * repeat), (long long)k,
+                repeat_steps_remaining[k], single_steps_remaining[k]);
+        }
+    }
+}
+
+// rewardDoneSystem computes every agent's reward, partner bonus and done in
+// one node per world. Over several episodes, with automatic resets, it must
+// give exactly the rewards (bonus included) and dones of running
+// rewardSystem, bonusRewardSystem and stepTrackerSystem as three nodes.
+static void testFusedRewards()
+{
+    Manager::Config cfg = cpuTestConfig(numWorlds);
+    Manager fused_mgr(cfg);
+
+    cfg.unfusedRewards = true;
+    Manager unfused_mgr(cfg);
+
+    RandomActions fused_actions(numWorlds, 99);
+    RandomActions unfused_actions(numWorlds, 99);
+
+    const int64_t num_agents = (int64_t)numWorlds * consts::numAgents;
+    int64_t num_dones = 0;
+    for (int64_t i = 0; i < 3 * consts::episodeLen + 10; i++) {
+        fused_actions.apply(fused_mgr);
+        unfused_actions.apply(unfused_mgr);
+        fused_mgr.step();
+        unfused_mgr.step();
+
+        compareFloats("fused rewards: reward",
+            tensorData<float>(fused_mgr.rewardTensor()),
+            tensorData<float>(unfused_mgr.rewardTensor()),
+            num_agents, 0.f);
+
+        const int32_t *fused_dones =
+            tensorData<int32_t>(fused_mgr.doneTensor());
+        const int32_t *unfused_dones =
+            tensorData<int32_t>(unfused_mgr.doneTensor());
+        for (int64_t k = 0; k < num_agents; k++) {
+            TEST_CHECK(fused_dones[k] == unfused_dones[k],
+                "step %lld agent %lld: done %d vs %d",
+                (long long)i, (long long)k,
+                fused_dones[k], unfused_dones[k]);
+            num_dones += unfused_dones[k];
+        }
+    }
+
+    // Three episode ends per agent
+    TEST_CHECK(num_dones == 3 * num_agents,
+               "%lld dones, expected %lld",
+               (long long)num_dones, (long long)(3 * num_agents));
+}
+
+// Writes a level bank with one level per world: generated levels in even
+// worlds, and in odd worlds levels where every room has two buttons with a
+// cube dropped next to each, its side within a few hundredths of the
+// button's edge. Every other odd world also moves the buttons onto
+// boundaries of buttonSystem's grid cells.
+static std::string writeButtonEdgeBank()
+{
+    // RoomType::CubeButtons in src/level_gen.cpp: 2 buttons, 2 cubes
+    constexpr uint32_t cube_buttons_room = 3;
+    // makeRoom spawns cubes at scale 1.5, a half extent of 1.5
+    constexpr float cube_edge_dist = consts::buttonWidth / 2.f + 1.5f;
+    constexpr float grid_cell_size = 4.f;
+
+    std::vector<LevelLayout> levels(numWorlds);
+    RandKey init_key = rand::initKey(11);
+    for (uint32_t w = 0; w < numWorlds; w++) {
+        RNG rng(rand::split_i(init_key, w, 0));
+        sampleLevelLayout(rng, levels[w]);
+
+        if (w % 2 == 0) {
+            continue;
+        }
+
+        for (CountT i = 0; i < consts::numRooms; i++) {
+            RoomLayout &room = levels[w].rooms[i];
+            room.type = cube_buttons_room;
+
+            float y_min = float(i) * consts::roomLength;
+            float y_max = y_min + consts::roomLength;
+
+            for (CountT j = 0; j < 2; j++) {
+                math::Vector2 &button = room.buttons[j];
+                if (w % 4 == 1) {
+                    button.x = j == 0 ? -6.f : 6.f;
+                    button.y = std::clamp(
+                        roundf(button.y / grid_cell_size) * grid_cell_size,
+                        y_min + 2.f, y_max - consts::wallWidth - 2.f);
+                }
+
+                // From 0.04 inside the button's edge to 0.04 outside it,
+                // on the side facing the middle of the room
+                float delta = 0.02f * float((w / 2 + i + j) % 5) - 0.04f;
+                float dist = cube_edge_dist + delta;
+                room.cubes[j] = {
+                    j == 0 ? button.x + dist : button.x - dist,
+                    button.y,
+                };
+            }
+        }
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() /
+        "mad_escape_button_edge_bank.lvl").string();
+
+    LevelBankHeader hdr {
+        .magic = levelBankMagic,
+        .version = levelBankVersion,
+        .layoutBytes = (uint32_t)sizeof(LevelLayout),
+        .numLevels = numWorlds,
+        .randSeed = 11,
+        .pad = {},
+    };
+
+    std::ofstream out(path, std::ios::binary);
+    out.write((const char *)&hdr, sizeof(LevelBankHeader));
+    out.write((const char *)levels.data(),
+              sizeof(LevelLayout) * levels.size());
+    TEST_CHECK(out.good(), "failed to write %s", path.c_str());
+
+    return path;
+}
+
+// Pins world i of mgr to level i of its level bank and restarts every world
+static void playBankLevelPerWorld(Manager &mgr)
+{
+    int32_t *select = (int32_t *)mgr.levelSelectTensor().devicePtr();
+    std::vector<int32_t> worlds(numWorlds);
+    for (uint32_t w = 0; w < numWorlds; w++) {
+        select[2 * w] = (int32_t)w;
+        worlds[w] = (int32_t)w;
+    }
+
+    mgr.triggerResets(worlds.data(), numWorlds);
+    mgr.reset();
+}
+
+// buttonSystem bins every body's CollisionAABB into a grid instead of
+// querying the BVH per button. With the same bodies and the same overlap
+// test, each step's ButtonPresses mask must match the BVH query's bit for
+// bit, on generated levels and on cubes resting right at button edges and
+// on buttons lying across grid cells.
+static void testButtonQuery()
+{
+    std::string bank_path = writeButtonEdgeBank();
+
+    Manager::Config cfg = cpuTestConfig(numWorlds);
+    cfg.levelBankPath = bank_path.c_str();
+    Manager grid_mgr(cfg);
+
+    cfg.bvhButtonQuery = true;
+    Manager bvh_mgr(cfg);
+
+    playBankLevelPerWorld(grid_mgr);
+    playBankLevelPerWorld(bvh_mgr);
+
+    RandomActions grid_actions(numWorlds, 99);
+    RandomActions bvh_actions(numWorlds, 99);
+
+    uint32_t any_pressed = 0;
+    for (int64_t i = 0; i < numSteps; i++) {
+        grid_actions.apply(grid_mgr);
+        bvh_actions.apply(bvh_mgr);
+        grid_mgr.step();
+        bvh_mgr.step();
+
+        // Column 0 is ButtonPresses::pressed
+        const uint32_t *grid_presses =
+            tensorData<uint32_t>(grid_mgr.buttonPressesTensor());
+        const uint32_t *bvh_presses =
+            tensorData<uint32_t>(bvh_mgr.buttonPressesTensor());
+        for (uint32_t w = 0; w < numWorlds; w++) {
+            TEST_CHECK(grid_presses[2 * w] == bvh_presses[2 * w],
+                "step %lld world %u: pressed 0x%x vs 0x%x",
+                (long long)i, w, grid_presses[2 * w], bvh_presses[2 * w]);
+            any_pressed |= bvh_presses[2 * w];
+        }
+    }
+
+    // The edge cubes that settled onto their buttons must have been seen
+    TEST_CHECK(any_pressed != 0, "no button was ever pressed");
+
+    std::filesystem::remove(bank_path);
+}
+
+int main(int argc, char *argv[])
+{
+    // Optionally run a single case by name
+    const char *only = argc > 1 ? argv[1] : nullptr;
+    auto run = [&](const char *name, void (*fn)()) {
+        if (only == nullptr || strcmp(only, name) == 0) {
+            printf("%s\n", name);
+            fn();
+        }
+    };
+
+    run("bvh_refit_lidar", testBVHRefitLidar);
+    run("simd_observations", testSIMDObservations);
+    run("planar_lidar", testPlanarLidar);
+    run("step_repeat", testStepRepeat);
+    run("fused_rewards", testFusedRewards);
+    run("button_query", testButtonQuery);
+
+    return testExitCode("sim_equivalence_test");
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "test_util.hpp"
+
+#include "../mgr.hpp"
+#include "../types.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Helpers for tests that drive whole simulators through Manager on the CPU
+// backend, where exported tensors are plain host memory.
+
+namespace madEscape::test {
+
+inline Manager::Config cpuTestConfig(uint32_t num_worlds)
+{
+    return Manager::Config {
+        .execMode = madrona::ExecMode::CPU,
+        .gpuID = 0,
+        .numWorlds = num_worlds,
+        .randSeed = 7,
+        .autoReset = true,
+        .enableBatchRenderer = false,
+    };
+}
+
+// Scripted random actions for every agent of every world, the same
+// sequence for any manager given the same seed
+class RandomActions {
+public:
+    RandomActions(uint32_t num_worlds, uint32_t seed)
+        : rng_(seed),
+          actions_(num_worlds * consts::numAgents)
+    {}
+
+    void apply(Manager &mgr)
+    {
+        std::uniform_int_distribution<int32_t> move_amount(0, 3);
+        std::uniform_int_distribution<int32_t> move_angle(0, 7);
+        std::uniform_int_distribution<int32_t> rotate(0, 4);
+        std::uniform_int_distribution<int32_t> grab(0, 15);
+
+        for (Action &action : actions_) {
+            action = Action {
+                .moveAmount = move_amount(rng_),
+                .moveAngle = move_angle(rng_),
+                .rotate = rotate(rng_),
+                .grab = grab(rng_) == 0 ? 1 : 0,
+            };
+        }
+
+        mgr.setActions(actions_.data(), (int64_t)actions_.size());
+    }
+
+    // Same actions without grabs, for tests where a grab toggled at a
+    // different step would be a legitimate difference
+    void applyNoGrab(Manager &mgr)
+    {
+        apply(mgr);
+        for (Action &action : actions_) {
+            action.grab = 0;
+        }
+        mgr.setActions(actions_.data(), (int64_t)actions_.size());
+    }
+
+private:
+    std::mt19937 rng_;
+    std::vector<Action> actions_;
+};
+
+template <typename T>
+inline const T * tensorData(const madrona::py::Tensor &tensor)
+{
+    return (const T *)tensor.devicePtr();
+}
+
+// Compares two float buffers of num_floats elements. With wrap_angles,
+// differences of 2 +- tolerance also pass, for angle observations that
+// wrap from 1 to -1. Returns the max difference.
+inline float compareFloats(const char *label,
+                           const float *a,
+                           const float *b,
+                           int64_t num_floats,
+                           float tolerance,
+                           bool wrap_angles = false)
+{
+    float max_diff = 0.f;
+    int32_t num_reported = 0;
+
+    for (int64_t i = 0; i < num_floats; i++) {
+        float diff = fabsf(a[i] - b[i]);
+        if (wrap_angles) {
+            diff = std::min(diff, fabsf(diff - 2.f));
+        }
+        max_diff = std::max(max_diff, diff);
+
+        // Keep the output readable when everything diverges
+        if (!(diff <= tolerance) && num_reported++ < 8) {
+            TEST_CHECK(diff <= tolerance, "%s[%lld]: %.9g vs %.9g",
+                       label, (long long)i, a[i], b[i]);
+        }
+    }
+
+    if (num_reported > 8) {
+        fprintf(stderr, "%s: %d more mismatches\n", label, num_reported - 8);
+        numFailures += num_reported - 8;
+    }
+
+    return max_diff;
+}
+
+// Number of floats in a per-agent component export of type T
+template <typename T>
+inline int64_t agentFloats(uint32_t num_worlds)
+{
+    static_assert(sizeof(T) % sizeof(float) == 0);
+    return (int64_t)num_worlds * consts::numAgents *
+        (int64_t)(sizeof(T) / sizeof(float));
+}
+
+// Compares the polar observations (self, partner, room entities, door) of
+// two managers
+inline void comparePolarObservations(const char *label,
+                                     Manager &a,
+                                     Manager &b,
+                                     uint32_t num_worlds,
+                                     float tolerance)
+{
+    char name[256];
+
+    snprintf(name, sizeof(name), "%s: self", label);
+    compareFloats(name,
+        tensorData<float>(a.selfObservationTensor()),
+        tensorData<float>(b.selfObservationTensor()),
+        agentFloats<SelfObservation>(num_worlds), tolerance, true);
+
+    snprintf(name, sizeof(name), "%s: partner", label);
+    compareFloats(name,
+        tensorData<float>(a.partnerObservationsTensor()),
+        tensorData<float>(b.partnerObservationsTensor()),
+        agentFloats<PartnerObservations>(num_worlds), tolerance, true);
+
+    snprintf(name, sizeof(name), "%s: room entities", label);
+    compareFloats(name,
+        tensorData<float>(a.roomEntityObservationsTensor()),
+        tensorData<float>(b.roomEntityObservationsTensor()),
+        agentFloats<RoomEntityObservations>(num_worlds), tolerance, true);
+
+    snprintf(name, sizeof(name), "%s: door", label);
+    compareFloats(name,
+        tensorData<float>(a.doorObservationTensor()),
+        tensorData<float>(b.doorObservationTensor()),
+        agentFloats<DoorObservation>(num_worlds), tolerance, true);
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// Minimal checking helpers for the test executables in this directory.
+// Failed checks are reported and counted, and testExitCode() turns the
+// count into the process exit code ctest looks at.
+
+namespace madEscape::test {
+
+inline int32_t numFailures = 0;
+
+inline int testExitCode(const char *test_name)
+{
+    if (numFailures == 0) {
+        printf("%s: passed\n", test_name);
+        return 0;
+    }
+
+    fprintf(stderr, "%s: %d checks failed\n", test_name, numFailures);
+    return 1;
+}
+
+}
+
+// TEST_CHECK(cond, fmt, ...) reports fmt when cond is false
+#define TEST_CHECK(cond, ...)                                               \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: check failed (%s): ", __FILE__,         \
+                    __LINE__, #cond);                                       \
+            fprintf(stderr, __VA_ARGS__);                                   \
+            fprintf(stderr, "\n");                                          \
+            ::madEscape::test::numFailures++;                               \
+        }                                                                   \
+    } while (0)
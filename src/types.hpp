@@ -5,6 +5,7 @@
 #include <madrona/rand.hpp>
 #include <madrona/physics.hpp>
 #include <madrona/render/ecs.hpp>
+#include <madrona/sync.hpp>
 
 #include "consts.hpp"
 
@@ -123,12 +124,85 @@ struct Lidar {
     LidarSample samples[consts::numLidarSamples];
 };
 
+// Compact copies of the observation components above, exported instead of
+// (or alongside) the fp32 versions when Sim::Config::compactObservations is
+// set. Float16Observation<T> holds each float of T as an IEEE half
+// precision bit pattern, in the same order.
+template <typename T>
+struct Float16Observation {
+    static constexpr madrona::CountT numValues = sizeof(T) / sizeof(float);
+    static_assert(sizeof(T) == numValues * sizeof(float));
+
+    uint16_t v[numValues];
+};
+
+using SelfObservationF16 = Float16Observation<SelfObservation>;
+using PartnerObservationsF16 = Float16Observation<PartnerObservations>;
+using RoomEntityObservationsF16 = Float16Observation<RoomEntityObservations>;
+using DoorObservationF16 = Float16Observation<DoorObservation>;
+
+// A lidar sample quantized to one byte for depth and one for type. depth is
+// LidarSample::depth clamped to [0, 1] and scaled to [0, 255], type is the
+// raw EntityType (so LidarSample::encodedType == type / NumTypes).
+struct LidarSampleU8 {
+    uint8_t depth;
+    uint8_t type;
+};
+
+struct LidarU8 {
+    LidarSampleU8 samples[consts::numLidarSamples];
+};
+
 // Number of steps remaining in the episode. Allows non-recurrent policies
 // to track the progression of time.
 struct StepsRemaining {
     uint32_t t;
 };
 
+// Every observation of an agent in one flat float array, filled in when
+// Sim::Config::fusedObservations is set so training code can read a single
+// [N, A, numFeatures] tensor. Offsets are in floats, each block holds the
+// floats of the named component in order:
+//   selfOffset            SelfObservation (8)
+//   partnerOffset         PartnerObservations (3 per other agent)
+//   roomEntityOffset      RoomEntityObservations (3 per entity)
+//   doorOffset            DoorObservation (3)
+//   lidarOffset           Lidar (2 per sample)
+//   stepsRemainingOffset  StepsRemaining::t / consts::episodeLen
+//   agentIDOffset         agent index / (numAgents - 1)
+// This matches the concatenation done by scripts/policy.py.
+struct FusedObservation {
+    static constexpr CountT selfOffset = 0;
+    static constexpr CountT partnerOffset =
+        selfOffset + sizeof(SelfObservation) / sizeof(float);
+    static constexpr CountT roomEntityOffset =
+        partnerOffset + sizeof(PartnerObservations) / sizeof(float);
+    static constexpr CountT doorOffset =
+        roomEntityOffset + sizeof(RoomEntityObservations) / sizeof(float);
+    static constexpr CountT lidarOffset =
+        doorOffset + sizeof(DoorObservation) / sizeof(float);
+    static constexpr CountT stepsRemainingOffset =
+        lidarOffset + sizeof(Lidar) / sizeof(float);
+    static constexpr CountT agentIDOffset = stepsRemainingOffset + 1;
+    static constexpr CountT numFeatures = agentIDOffset + 1;
+
+    float v[numFeatures];
+};
+
+// Ring buffer of the last consts::numStackedFrames FusedObservation frames
+// of an agent, filled in when Sim::Config::frameStacking is set so
+// non-recurrent policies don't have to stack observations themselves.
+// ObservationFrameHead::idx is the slot holding the newest frame, the frame
+// k steps older is in slot (idx - k) mod numStackedFrames. Slots that
+// haven't been written yet this episode are zero.
+struct ObservationFrames {
+    float frames[consts::numStackedFrames][FusedObservation::numFeatures];
+};
+
+struct ObservationFrameHead {
+    int32_t idx;
+};
+
 // Tracks progress the agent has made through the challenge, used to add
 // reward when more progress has been made
 struct Progress {
@@ -141,6 +215,12 @@ struct OtherAgents {
     madrona::Entity e[consts::numAgents - 1];
 };
 
+// Per-agent component holding the agent's index in Sim::agents, set once
+// when the agents are created
+struct AgentID {
+    int32_t idx;
+};
+
 // Tracks if an agent is currently grabbing another entity
 struct GrabState {
     Entity constraintEntity;
@@ -167,10 +247,10 @@ struct OpenState {
 };
 
 // Linked buttons that control the door opening and whether or not the door
-// should remain open after the buttons are pressed once.
+// should remain open after the buttons are pressed once. The buttons are
+// the set bits of buttonMask, indexed as in ButtonPresses.
 struct DoorProperties {
-    Entity buttons[consts::maxEntitiesPerRoom];
-    int32_t numButtons;
+    uint32_t buttonMask;
     bool isPersistent;
 };
 
@@ -179,6 +259,37 @@ struct ButtonState {
     bool isPressed;
 };
 
+// Bit of button slot slot_idx of room room_idx in ButtonPresses::pressed and
+// DoorProperties::buttonMask. Buttons always occupy the first entity slots
+// of their room.
+inline uint32_t buttonBit(madrona::CountT room_idx, madrona::CountT slot_idx)
+{
+    return 1u << (room_idx * consts::maxButtonsPerRoom + slot_idx);
+}
+
+// Strictly less than 32: the top bit must stay clear so pressed can never
+// equal the ~0u doorsEvaluated sentinel below
+static_assert(consts::numRooms * consts::maxButtonsPerRoom < 32);
+
+// A per-world singleton with one bit per button of the level, set while the
+// button is pressed (buttonSystem in src/sim.cpp). Doors are only
+// re-evaluated when pressed differs from doorsEvaluated, the value they were
+// last evaluated against; level generation sets doorsEvaluated to ~0u so the
+// doors of a new level are always evaluated once.
+struct ButtonPresses {
+    uint32_t pressed;
+    uint32_t doorsEvaluated;
+};
+
+// A per-world singleton with bit i set while the door of room i is moving
+// towards the position its OpenState asks for. doorOpenSystem sets a door's
+// bit when it changes the door's OpenState, and setDoorPositionSystem clears
+// it once the door is at rest. Level generation places every door closed
+// and at rest, so it starts out as 0.
+struct MovingDoors {
+    uint32_t mask;
+};
+
 // Room itself is not a component but is used by the singleton
 // component "LevelState" (below) to represent the state of the full level
 struct Room {
@@ -198,6 +309,101 @@ struct LevelState {
     Room rooms[consts::numRooms];
 };
 
+// A singleton component counting the steps of the current
+// Manager::step(num_steps) call that already ran (RepeatStep graph runs).
+// Zero at the first step of every call.
+//
+// Done is latched over the steps of a call, so it can't tell resetSystem
+// whether the episode ended on the latest step. stepDone holds each agent's
+// Done for that step alone, as a single step call would have set it, and
+// is what resetSystem reads.
+struct StepRepeat {
+    int32_t stepIdx;
+    int32_t stepDone[consts::numAgents];
+};
+
+// Phases of the Step task graph timed when Sim::Config::taskTimings is set,
+// in execution order.
+enum class TaskPhase : uint32_t {
+    Movement,
+    Broadphase,
+    Grab,
+    Physics,
+    Buttons,
+    Rewards,
+    Reset,
+    Observations,
+    Lidar,
+    NumPhases,
+};
+
+// A singleton component accumulating the wall-clock time spent in each
+// TaskPhase. All worlds run every node together, so only world 0 records
+// timestamps, at the node boundaries between phases. numSteps counts the
+// timed Step graph runs, i.e. Manager::step calls: the simulation phases of
+// the RepeatStep runs of step(num_steps) add to the same sums without being
+// counted, so averages are per call. lastTimestamp is the end of the
+// previous phase.
+struct TaskTimings {
+    int64_t phaseNs[(uint32_t)TaskPhase::NumPhases];
+    int64_t numSteps;
+    int64_t lastTimestamp;
+};
+
+// Pre-allocated entities that level generation re-initializes on every reset
+// rather than destroying and recreating them. Walls and doors map 1:1 to
+// rooms, while cubes and buttons are handed out in order as the rooms of the
+// current level request them. Pool entries the level doesn't use are parked
+// outside the play area. Lives in Sim since it is only touched on reset.
+struct LevelEntityPool {
+    Entity walls[consts::numRooms][2];
+    Entity doors[consts::numRooms];
+    Entity cubes[consts::numRooms * consts::maxCubesPerRoom];
+    Entity buttons[consts::numRooms * consts::maxButtonsPerRoom];
+    CountT numCubesUsed;
+    CountT numButtonsUsed;
+};
+
+// RoomLayout and LevelLayout are not components. They hold every value
+// level generation draws from the RNG, so a level can either be sampled
+// on the fly or read back from a precomputed level bank (src/level_bank.hpp).
+// Both are plain data and are written to disk as-is.
+struct RoomLayout {
+    uint32_t type; // RoomType (src/level_gen.cpp)
+    float doorCenter;
+    // Only the first N buttons / cubes are used, as implied by the type
+    madrona::math::Vector2 buttons[consts::maxButtonsPerRoom];
+    madrona::math::Vector2 cubes[consts::maxCubesPerRoom];
+};
+
+struct LevelLayout {
+    madrona::math::Vector2 agentPositions[consts::numAgents];
+    float agentYaws[consts::numAgents];
+    RoomLayout rooms[consts::numRooms];
+};
+
+// Handoff slot between a world and the CPU backend's level prefetch thread
+// (src/level_prefetch.hpp), one per world. The world publishes the episode
+// it will start next in requestedEpisode; the prefetch thread samples that
+// episode's layout and then publishes it in readyEpisode. The world only
+// reads layout when readyEpisode matches and the thread only writes it while
+// they differ, so the two never touch layout at the same time.
+struct LevelPrefetchSlot {
+    madrona::AtomicU32 requestedEpisode;
+    madrona::AtomicU32 readyEpisode;
+    LevelLayout layout;
+};
+
+// LevelSelect is a per-world singleton that picks the level bank entry used
+// by the next episode. Setting requested to a bank index before a reset pins
+// the world to that level; -1 picks one from the episode's random key, as
+// does any index outside the bank. current is the index being played, or -1
+// when no level bank is loaded.
+struct LevelSelect {
+    int32_t requested;
+    int32_t current;
+};
+
 
 
 // ========================================================= MY COMPONENTS ========================================================= 
@@ -226,6 +432,7 @@ struct Agent : public madrona::Archetype<
     GrabState,
     Progress,
     OtherAgents,
+    AgentID,
     EntityType,
 
     // Input
@@ -239,6 +446,18 @@ struct Agent : public madrona::Archetype<
     Lidar,
     StepsRemaining,
 
+    // Optional observation exports, only filled in when
+    // Sim::Config::compactObservations / fusedObservations / frameStacking
+    // is set. Their storage is allocated for every agent regardless.
+    SelfObservationF16,
+    PartnerObservationsF16,
+    RoomEntityObservationsF16,
+    DoorObservationF16,
+    LidarU8,
+    FusedObservation,
+    ObservationFrames,
+    ObservationFrameHead,
+
     // Reward, episode termination
     Reward,
     Done,
@@ -110,6 +110,7 @@ int main(int argc, char *argv[])
 
         printf("Step: %u\n", cur_replay_step);
 
+        HeapArray<Action> step_actions(num_worlds * num_views);
         for (uint32_t i = 0; i < num_worlds; i++) {
             for (uint32_t j = 0; j < num_views; j++) {
                 uint32_t base_idx = 0;
@@ -123,10 +124,17 @@ int main(int argc, char *argv[])
 
                 printf("%d, %d: %d %d %d %d\n",
                        i, j, move_amount, move_angle, turn, g);
-                mgr.setAction(i, j, move_amount, move_angle, turn, g);
+                step_actions[i * num_views + j] = Action {
+                    .moveAmount = move_amount,
+                    .moveAngle = move_angle,
+                    .rotate = turn,
+                    .grab = g,
+                };
             }
         }
 
+        mgr.setActions(step_actions.data(), step_actions.size());
+
         cur_replay_step++;
 
         return false;
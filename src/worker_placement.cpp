@@ -0,0 +1,238 @@
+#include "worker_placement.hpp"
+
+#include <madrona/crash.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace madEscape {
+
+#if defined(__linux__)
+
+// From linux/mempolicy.h, which isn't always installed
+static constexpr int mpolDefault = 0;
+static constexpr int mpolPreferred = 1;
+static constexpr unsigned long maxNumaNodes = 1024;
+
+static std::vector<int32_t> listThreads()
+{
+    std::vector<int32_t> tids;
+    for (const auto &entry :
+            std::filesystem::directory_iterator("/proc/self/task")) {
+        tids.push_back((int32_t)std::stol(entry.path().filename().string()));
+    }
+    std::sort(tids.begin(), tids.end());
+
+    return tids;
+}
+
+// Parses a kernel CPU list such as "0-15,32-47"
+static std::vector<int32_t> parseCPUList(const std::string &list)
+{
+    std::vector<int32_t> cpus;
+
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+
+        std::string range = list.substr(start, end - start);
+        size_t dash = range.find('-');
+        if (!range.empty()) {
+            int32_t first = (int32_t)std::stol(range.substr(0, dash));
+            int32_t last = dash == std::string::npos ?
+                first : (int32_t)std::stol(range.substr(dash + 1));
+            for (int32_t cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        start = end + 1;
+    }
+
+    return cpus;
+}
+
+static std::vector<int32_t> numaNodeCPUs(int32_t numa_node)
+{
+    std::string path = "/sys/devices/system/node/node" +
+        std::to_string(numa_node) + "/cpulist";
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        FATAL("NUMA node %d does not exist", numa_node);
+    }
+
+    std::string list;
+    std::getline(file, list);
+
+    return parseCPUList(list);
+}
+
+// Returns false, with a warning, if the kernel refused the affinity, e.g.
+// because the thread already exited or a cgroup forbids the CPUs
+static bool setThreadCPUs(pid_t tid, const std::vector<int32_t> &cpus)
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int32_t cpu : cpus) {
+        CPU_SET(cpu, &mask);
+    }
+
+    if (sched_setaffinity(tid, sizeof(mask), &mask) != 0) {
+        fprintf(stderr, "Failed to set the CPU affinity of thread %d: %s\n",
+                (int)tid, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+static void setMemPolicy(int mode, const uint64_t *node_mask)
+{
+    if (syscall(SYS_set_mempolicy, mode, node_mask,
+                node_mask == nullptr ? 0 : maxNumaNodes) != 0) {
+        fprintf(stderr, "Failed to set the NUMA memory policy: %s\n",
+                strerror(errno));
+    }
+}
+
+WorkerPlacement::WorkerPlacement(int32_t numa_node)
+    : cpus_(),
+      existingThreads_(listThreads()),
+      prevCPUMask_(),
+      prevNodeMask_(),
+      prevMemPolicy_(mpolDefault),
+      restore_(numa_node >= 0)
+{
+    cpu_set_t cur_mask;
+    CPU_ZERO(&cur_mask);
+    sched_getaffinity(0, sizeof(cur_mask), &cur_mask);
+
+    std::vector<int32_t> node_cpus;
+    if (numa_node >= 0) {
+        node_cpus = numaNodeCPUs(numa_node);
+    }
+
+    for (int32_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &cur_mask)) {
+            continue;
+        }
+
+        if (numa_node < 0 || std::find(node_cpus.begin(), node_cpus.end(),
+                                       cpu) != node_cpus.end()) {
+            cpus_.push_back(cpu);
+        }
+    }
+
+    if (cpus_.empty()) {
+        FATAL("No usable CPU on NUMA node %d", numa_node);
+    }
+
+    if (!restore_) {
+        return;
+    }
+
+    prevCPUMask_.resize(sizeof(cpu_set_t) / sizeof(uint64_t));
+    memcpy(prevCPUMask_.data(), &cur_mask, sizeof(cpu_set_t));
+
+    prevNodeMask_.resize(maxNumaNodes / 64);
+    int mode = mpolDefault;
+    if (syscall(SYS_get_mempolicy, &mode, prevNodeMask_.data(),
+                maxNumaNodes, nullptr, 0) != 0) {
+        mode = mpolDefault;
+    }
+    prevMemPolicy_ = mode;
+
+    // Placement is a performance hint, so the workers still run if the
+    // kernel refuses it
+    setThreadCPUs(0, cpus_);
+
+    std::vector<uint64_t> node_mask(maxNumaNodes / 64, 0);
+    node_mask[numa_node / 64] |= 1ull << (numa_node % 64);
+    setMemPolicy(mpolPreferred, node_mask.data());
+}
+
+WorkerPlacement::~WorkerPlacement()
+{
+    if (!restore_) {
+        return;
+    }
+
+    if (sched_setaffinity(0, sizeof(cpu_set_t),
+            (const cpu_set_t *)prevCPUMask_.data()) != 0) {
+        fprintf(stderr, "Failed to restore the CPU affinity: %s\n",
+                strerror(errno));
+    }
+
+    if (prevMemPolicy_ == mpolDefault) {
+        setMemPolicy(mpolDefault, nullptr);
+    } else {
+        setMemPolicy(prevMemPolicy_, prevNodeMask_.data());
+    }
+}
+
+bool WorkerPlacement::pinNewThreads(uint32_t num_workers)
+{
+    std::vector<int32_t> new_threads;
+    for (int32_t tid : listThreads()) {
+        if (!std::binary_search(existingThreads_.begin(),
+                                existingThreads_.end(), tid)) {
+            new_threads.push_back(tid);
+        }
+    }
+
+    // Other code (e.g. a Python or PyTorch thread pool) started threads
+    // while the executor was being built. They can't be told apart from
+    // the workers, so leave every thread to the OS rather than pin a
+    // foreign one to a worker's CPU.
+    if (new_threads.size() > num_workers) {
+        fprintf(stderr, "Not pinning worker threads: %zu threads started "
+                "for %u workers\n", new_threads.size(), num_workers);
+        return false;
+    }
+
+    bool all_pinned = true;
+    size_t next_cpu = 0;
+    for (int32_t tid : new_threads) {
+        if (!setThreadCPUs(tid, { cpus_[next_cpu] })) {
+            all_pinned = false;
+        }
+        next_cpu = (next_cpu + 1) % cpus_.size();
+    }
+
+    return all_pinned;
+}
+
+#else
+
+WorkerPlacement::WorkerPlacement(int32_t)
+    : cpus_(),
+      existingThreads_(),
+      prevCPUMask_(),
+      prevNodeMask_(),
+      prevMemPolicy_(0),
+      restore_(false)
+{}
+
+WorkerPlacement::~WorkerPlacement() {}
+
+bool WorkerPlacement::pinNewThreads(uint32_t) { return false; }
+
+#endif
+
+}
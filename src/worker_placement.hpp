@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace madEscape {
+
+// Controls where the worker threads of the CPU executor run and where the
+// memory they touch is allocated. The executor creates its threads and
+// initializes the worlds inside its constructor, so a WorkerPlacement is
+// constructed right before it and applies to everything created while it
+// is alive:
+//
+//  - With a NUMA node, the calling thread is restricted to the node's CPUs
+//    and its allocations prefer the node's memory. Threads inherit both,
+//    so the workers run on the node and the ECS tables they first touch
+//    are local to it.
+//  - pinNewThreads() then pins each thread created since construction to
+//    a single CPU of the allowed set. /proc doesn't say which code started
+//    a thread, so if more threads appeared than the executor's workers,
+//    some belong to someone else and none are pinned.
+//
+// The calling thread's own affinity and memory policy are restored on
+// destruction. Linux only, elsewhere this does nothing.
+class WorkerPlacement {
+public:
+    // numa_node < 0 leaves placement to the OS
+    WorkerPlacement(int32_t numa_node);
+    ~WorkerPlacement();
+
+    WorkerPlacement(const WorkerPlacement &) = delete;
+    WorkerPlacement & operator=(const WorkerPlacement &) = delete;
+
+    // Pins the threads created since construction, provided there are at
+    // most num_workers of them. Returns whether all of them were pinned;
+    // threads the kernel refused to pin are reported on stderr.
+    bool pinNewThreads(uint32_t num_workers);
+
+    // Number of CPUs the threads may run on
+    inline uint32_t numCPUs() const { return (uint32_t)cpus_.size(); }
+
+private:
+    std::vector<int32_t> cpus_;
+    std::vector<int32_t> existingThreads_;
+    std::vector<uint64_t> prevCPUMask_;
+    std::vector<uint64_t> prevNodeMask_;
+    int32_t prevMemPolicy_;
+    bool restore_;
+};
+
+}